@@ -3,6 +3,8 @@
 #undef  OK
 #define OK  (0)
 
+const char *change_scroll_region = "\x1b[%ld;%ldr"; /* DECSTBM */
+const char *clear_margins = NULL; /* DECSLRM: not supported by all terminals */
 const char *clr_eol = "\x1b[K";
 const char *clear_screen = "\x1b[H\x1b[2J";
 const char *cursor_address = "\x1b[%ld;%ldH";
@@ -13,6 +15,9 @@ const char *enter_ca_mode = "\x1b[?1049h"; /* smcup */
 const char *exit_ca_mode = "\x1b[?1049l"; /* rmcup */
 const char *save_cursor = "\x1b""7";
 const char *restore_cursor = "\x1b""8";
+const char *scroll_forward = "\n";
+const char *scroll_reverse = "\x1b""M";
+const char *set_lr_margin = NULL; /* DECSLRM: not supported by all terminals */
 const char *exit_attribute_mode = "\x1b[0m";
 const char *enter_bold_mode = "\x1b[1m";
 const char *enter_dim_mode = "\x1b[2m";
@@ -29,7 +34,7 @@ tparm(const char *s, long p1, long p2, ...)
 {
 	static char buf[32];
 
-	if (s == cursor_address) {
+	if (s == cursor_address || s == change_scroll_region) {
 		snprintf(buf, sizeof(buf), s, p1 + 1, p2 + 1);
 		return buf;
 	}
@@ -0,0 +1,345 @@
+/* Benchmark of the hot paths of sfeed_curses: loading, counting, the read
+   URLs, searching and drawing. The source is included to time the internal
+   functions, the main() of sfeed_curses is not used.
+
+   A synthetic corpus of sfeed(5) TSV files and a urlfile is generated in a
+   temporary directory, see usage(). The frames are drawn to /dev/null with
+   minicurses. */
+#include <limits.h>
+
+#define main sfeed_curses_main
+#include "sfeed_curses.c"
+#undef main
+
+static FILE *resfp; /* results, stdout is used by drawing */
+static int rounds = 3;
+static volatile size_t sink; /* keep the results of the lookups */
+
+/* deterministic pseudo-random numbers: xorshift64 */
+static uint64_t rngstate = 0x2545f4914f6cdd1dULL;
+
+static uint64_t
+rng(void)
+{
+	rngstate ^= rngstate << 13;
+	rngstate ^= rngstate >> 7;
+	rngstate ^= rngstate << 17;
+	return rngstate;
+}
+
+static double
+now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+/* Print the best time of the rounds, the amount of operations is per round. */
+static void
+result(const char *name, size_t ops, double best)
+{
+	fprintf(resfp, "%-24s %10zu ops %10.3f ms %10.1f ns/op\n",
+	        name, ops, best, ops ? best * 1000000.0 / ops : 0.0);
+	fflush(resfp);
+}
+
+static const char *words[] = {
+	"news", "release", "update", "linux", "security", "kernel", "review",
+	"weekly", "notes", "patch", "server", "desktop", "mobile", "maemo"
+};
+
+/* text with different widths: accented, CJK and emoji */
+static const char *utf8words[] = {
+	"ünïcödé", "日本語", "한국어", "Ελληνικά", "русский", "😀", "ｗｉｄｅ"
+};
+
+static void
+genwords(FILE *fp, int n, int utf8pct)
+{
+	int i;
+
+	for (i = 0; i < n; i++) {
+		if (i)
+			fputc(' ', fp);
+		if ((int)(rng() % 100) < utf8pct)
+			fputs(utf8words[rng() % LEN(utf8words)], fp);
+		else
+			fputs(words[rng() % LEN(words)], fp);
+	}
+}
+
+/* Generate `nfeed' feed files with `nitems' items each and a urlfile with
+   `nurl' URLs of the items, `utf8pct' is the percentage of non-ASCII
+   words. */
+static void
+gencorpus(const char *dir, int nfeed, int nitems, int utf8pct, int nurl)
+{
+	FILE *fp;
+	char path[PATH_MAX];
+	time_t t;
+	int i, j;
+
+	t = time(NULL);
+	for (i = 0; i < nfeed; i++) {
+		snprintf(path, sizeof(path), "%s/feed%d", dir, i);
+		if (!(fp = fopen(path, "w")))
+			die("fopen: %s", path);
+		for (j = 0; j < nitems; j++) {
+			/* newest first, some items are new */
+			fprintf(fp, "%lld\t", (long long)(t - (j * 3600LL) -
+			        (long long)(rng() % 3600)));
+			genwords(fp, 3 + rng() % 8, utf8pct);
+			fprintf(fp, "\thttps://example.org/%d/%d\t", i, j);
+			genwords(fp, 20 + rng() % 60, utf8pct);
+			fprintf(fp, "\thtml\tid%d-%d\t", i, j);
+			genwords(fp, 1, utf8pct);
+			fputc('\t', fp);
+			if (rng() % 4 == 0)
+				fprintf(fp, "https://example.org/%d/%d.mp3", i, j);
+			fputc('\t', fp);
+			genwords(fp, rng() % 3, 0);
+			fputc('\n', fp);
+		}
+		if (fclose(fp))
+			die("fclose: %s", path);
+	}
+
+	snprintf(path, sizeof(path), "%s/urls", dir);
+	if (!(fp = fopen(path, "w")))
+		die("fopen: %s", path);
+	for (i = 0; i < nurl; i++)
+		fprintf(fp, "https://example.org/%d/%d\n",
+		        (int)(rng() % nfeed), (int)(rng() % nitems));
+	if (fclose(fp))
+		die("fclose: %s", path);
+}
+
+static void
+bench_urls(void)
+{
+	char url[64];
+	double t, best = 0.0;
+	size_t i, n = 100000;
+	int r;
+
+	for (r = 0; r < rounds; r++) {
+		urls_free();
+		t = now();
+		urls_read();
+		t = now() - t;
+		if (!r || t < best)
+			best = t;
+	}
+	result("urls_read", nurls, best);
+
+	for (r = 0; r < rounds; r++) {
+		t = now();
+		for (i = 0; i < n; i++) {
+			snprintf(url, sizeof(url), "https://example.org/%d/%d",
+			         (int)(i % nfeeds), (int)(i % 1000));
+			sink += !urls_isnew(url);
+		}
+		t = now() - t;
+		if (!r || t < best)
+			best = t;
+	}
+	result("urls_isnew", n, best);
+}
+
+static void
+bench_load(const char *name, int lazy)
+{
+	struct items items;
+	FILE *fp;
+	double t, best = 0.0;
+	size_t i, n = 0;
+	int r;
+
+	lazyload = lazy;
+	for (r = 0; r < rounds; r++) {
+		n = 0;
+		t = now();
+		for (i = 0; i < nfeeds; i++) {
+			if (!(fp = fopen(feeds[i].path, "rb")))
+				die("fopen: %s", feeds[i].path);
+			memset(&items, 0, sizeof(items));
+			feed_items_get(&feeds[i], fp, &items);
+			n += items.len;
+			feed_items_free(&items);
+			fclose(fp);
+		}
+		t = now() - t;
+		if (!r || t < best)
+			best = t;
+	}
+	lazyload = 0;
+	result(name, n, best);
+}
+
+static void
+bench_count(void)
+{
+	FILE *fp;
+	double t, best = 0.0;
+	size_t i, n = 0;
+	int r;
+
+	for (r = 0; r < rounds; r++) {
+		n = 0;
+		t = now();
+		for (i = 0; i < nfeeds; i++) {
+			if (!(fp = fopen(feeds[i].path, "rb")))
+				die("fopen: %s", feeds[i].path);
+			feed_count(&feeds[i], fp);
+			n += feeds[i].total;
+			fclose(fp);
+		}
+		t = now() - t;
+		if (!r || t < best)
+			best = t;
+	}
+	result("feed_count", n, best);
+}
+
+/* Search all the items of the loaded feed for text which is not found: with
+   a title match and a text which requires the formatted row. */
+static void
+bench_search(const char *name, const char *s)
+{
+	struct pane *p = &panes[PaneItems];
+	double t, best = 0.0;
+	int r;
+
+	for (r = 0; r < rounds; r++) {
+		t = now();
+		if (pane_search(p, 0, s, 1) != -1)
+			die("search: %s: unexpected match", s);
+		t = now() - t;
+		if (!r || t < best)
+			best = t;
+	}
+	result(name, p->nrows, best);
+}
+
+/* Draw full frames and scroll by pages through the loaded feed. */
+static void
+bench_draw(void)
+{
+	struct pane *p = &panes[PaneItems];
+	double t, best = 0.0;
+	size_t i, n = 200;
+	int r;
+
+	for (r = 0; r < rounds; r++) {
+		pane_setpos(p, 0);
+		t = now();
+		for (i = 0; i < n; i++) {
+			alldirty();
+			draw();
+			pane_scrollpage(p, +1);
+		}
+		t = now() - t;
+		if (!r || t < best)
+			best = t;
+	}
+	result("draw", n, best);
+}
+
+static void
+usage(void)
+{
+	fputs("usage: sfeed_bench [-f feeds] [-n items] [-u utf8pct] "
+	      "[-U urls] [-r rounds] [-w width] [-h height]\n", stderr);
+	exit(1);
+}
+
+int
+main(int argc, char *argv[])
+{
+	char dir[] = "/tmp/sfeed_bench.XXXXXX", path[PATH_MAX];
+	static char urlpath[PATH_MAX];
+	int i, nfeed = 20, nitems = 5000, utf8pct = 10, nurlsgen = 20000;
+	int width = 160, height = 50, fd;
+
+	for (i = 1; i < argc; i++) {
+		if (argv[i][0] != '-' || !argv[i][1] || argv[i][2] || i + 1 >= argc)
+			usage();
+		switch (argv[i++][1]) {
+		case 'f': nfeed = MAX(atoi(argv[i]), 1); break;
+		case 'n': nitems = MAX(atoi(argv[i]), 1); break;
+		case 'u': utf8pct = MIN(MAX(atoi(argv[i]), 0), 100); break;
+		case 'U': nurlsgen = MAX(atoi(argv[i]), 0); break;
+		case 'r': rounds = MAX(atoi(argv[i]), 1); break;
+		case 'w': width = MAX(atoi(argv[i]), 20); break;
+		case 'h': height = MAX(atoi(argv[i]), 5); break;
+		default: usage();
+		}
+	}
+
+	setlocale(LC_CTYPE, "");
+
+	/* the frames are drawn to /dev/null */
+	if ((fd = dup(1)) == -1 || !(resfp = fdopen(fd, "w")))
+		die("dup");
+	if (!freopen("/dev/null", "w", stdout))
+		die("freopen: /dev/null");
+	setvbuf(stdout, NULL, _IOFBF, 65536);
+
+	if (!mkdtemp(dir))
+		die("mkdtemp: %s", dir);
+	gencorpus(dir, nfeed, nitems, utf8pct, nurlsgen);
+	fprintf(resfp, "corpus: %d feeds, %d items, %d%% UTF-8, %d URLs in %s\n",
+	        nfeed, nitems, utf8pct, nurlsgen, dir);
+
+	snprintf(urlpath, sizeof(urlpath), "%s/urls", dir);
+	urlfile = urlpath;
+	if ((comparetime = time(NULL)) == -1)
+		die("time");
+	comparetime -= 86400;
+
+	setlayout(LayoutVertical);
+	selpane = PaneItems;
+	panes[PaneFeeds].row_format = feed_row_format;
+	panes[PaneFeeds].row_match = feed_row_match;
+	panes[PaneItems].row_get = item_row_get;
+	panes[PaneItems].row_format = item_row_format;
+	panes[PaneItems].row_match = item_row_match;
+
+	nfeeds = nfeed;
+	feeds = ecalloc(nfeeds, sizeof(struct feed));
+	for (i = 0; i < nfeed; i++) {
+		snprintf(path, sizeof(path), "%s/feed%d", dir, i);
+		feeds[i].path = estrdup(path);
+		feeds[i].name = strrchr(feeds[i].path, '/') + 1;
+		feeds[i].namew = colw(feeds[i].name);
+		feeds[i].nameplain = utf8width(feeds[i].name) != -1;
+	}
+
+	bench_urls();
+	bench_load("feed_items_get", 0);
+	bench_load("feed_items_get (lazy)", 1);
+	bench_count();
+
+	/* load the first feed */
+	win_update(&win, width, height);
+	feeds_set(&feeds[0]);
+	feed_load(&feeds[0], feeds[0].fp);
+	updatesidebar();
+	updategeom();
+	bench_search("search (title)", "zzzz");
+	bench_search("search (row)", "2000-01-01 00:00");
+	bench_draw();
+
+	/* remove the corpus */
+	feeds_set(NULL);
+	for (i = 0; i < nfeed; i++) {
+		if (unlink(feeds[i].path) == -1)
+			die("unlink: %s", feeds[i].path);
+	}
+	if (unlink(urlpath) == -1 || rmdir(dir) == -1)
+		die("rmdir: %s", dir);
+
+	return 0;
+}
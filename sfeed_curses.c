@@ -1,5 +1,10 @@
 #include <sys/ioctl.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+#include <sys/mman.h>
 #include <sys/select.h>
+#include <sys/stat.h>
 #include <sys/time.h>
 #include <sys/types.h>
 #include <sys/wait.h>
@@ -8,17 +13,37 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <locale.h>
+#include <pthread.h>
+#include <setjmp.h>
 #include <signal.h>
+#include <spawn.h>
 #include <stdarg.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <termios.h>
 #include <time.h>
 #include <unistd.h>
 #include <wchar.h>
 
 /* curses */
+#ifdef SFEED_SIMD
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define SFEED_NEON
+#else
+#undef SFEED_SIMD /* not supported: use the portable version */
+#endif
+#endif
+
+#ifdef SFEED_GZIP
+#include <zlib.h>
+#endif
+
 #ifndef SFEED_MINICURSES
 #include <curses.h>
 #include <term.h>
@@ -30,6 +55,15 @@
 #define MAX(a,b) ((a) > (b) ? (a) : (b))
 #define MIN(a,b) ((a) < (b) ? (a) : (b))
 
+#define ARENA_BLOCKSIZE        (256 * 1024) /* default size of an arena block */
+#define AUTORELOAD_DELAY       1 /* seconds without changes before reloading */
+#define STREAM_READSIZE        65536 /* size of a read from the stdin stream */
+#define LINES_READSIZE         65536 /* size of a read of the line reader */
+#define LAZY_BLOCKITEMS        64 /* items per lazy-loaded block */
+#define LAZY_BLOCKS            32 /* maximum lazy-loaded blocks in memory */
+#define GZ_SPAN                (1024 * 1024) /* uncompressed bytes per checkpoint */
+#define GZ_WINSIZE             32768 /* size of the window of deflate */
+
 #define PAD_TRUNCATE_SYMBOL    "\xe2\x80\xa6" /* symbol: "ellipsis" */
 #define SCROLLBAR_SYMBOL_BAR   "\xe2\x94\x82" /* symbol: "light vertical" */
 #define SCROLLBAR_SYMBOL_TICK  " "
@@ -59,6 +93,13 @@ enum {
 	FieldCategory, FieldLast
 };
 
+/* sort orders and filters of the items pane */
+enum { SortFile = 0, SortTime, SortTitle, SortAuthor, SortLast };
+enum {
+	FilterNew = 1, FilterEnclosure = 2, FilterCategory = 4, FilterLast = 8
+};
+static const char *sortnames[] = { "file", "time", "title", "author" };
+
 struct win {
 	int width; /* absolute width of the window */
 	int height; /* absolute height of the window */
@@ -68,6 +109,9 @@ struct win {
 struct row {
 	char *text; /* text string, optional if using row_format() callback */
 	int bold;
+	/* display width of the text if it has only printable characters, else
+	   -1, can be set by the row_format() callback */
+	int textw;
 	void *data; /* data binding */
 };
 
@@ -77,11 +121,15 @@ struct pane {
 	int width; /* absolute width of the pane */
 	int height; /* absolute height of the pane, should be > 0 */
 	off_t pos; /* focused row position */
+	off_t top; /* first visible row when scrolling by lines */
 	struct row *rows;
 	size_t nrows; /* total amount of rows */
 	int focused; /* has focus or not */
 	int hidden; /* is visible or not */
 	int dirty; /* needs draw update */
+	/* hash of the rows drawn on the screen by position, 0 if not drawn */
+	uint64_t *drawn;
+	int ndrawn;
 	/* (optional) callback functions */
 	struct row *(*row_get)(struct pane *, off_t pos);
 	char *(*row_format)(struct pane *, struct row *);
@@ -97,6 +145,9 @@ struct scrollbar {
 	int focused; /* has focus or not */
 	int hidden; /* is visible or not */
 	int dirty; /* needs draw update */
+	/* state of the cells drawn on the screen by position, 0 if not drawn */
+	unsigned char *drawn;
+	int ndrawn;
 };
 
 struct statusbar {
@@ -118,43 +169,235 @@ struct linebar {
 
 /* /UI */
 
+/* block of memory for an arena */
+struct arenablock {
+	struct arenablock *next;
+	size_t len;             /* used bytes */
+	size_t cap;             /* available bytes */
+	char data[];
+};
+
+/* bump allocator: allocations are only freed all at once */
+struct arena {
+	struct arenablock *blocks; /* list of blocks, the first block is used */
+};
+
 struct item {
-	char *fields[FieldLast];
-	char *line; /* allocated split line */
-	/* field to match new items, if link is set match on link, else on id */
-	char *matchnew;
+	char *line; /* split line, allocated in the arena or the mapping */
 	time_t timestamp;
-	int timeok;
-	int isnew;
 	off_t offset; /* line offset in file for lazyload */
+	/* hash of the field to match new items, set if using an index or
+	   $SFEED_URL_FILE */
+	uint64_t hash;
+	uint32_t fields[FieldLast]; /* offsets of the fields in the line */
+	uint32_t titlew; /* cached display width of the title */
+	unsigned int timeok : 1;
+	unsigned int isnew : 1;
+	unsigned int titleset : 1; /* the width of the title is cached */
+	unsigned int titleplain : 1; /* title has only printable characters */
+	unsigned int feed : 28; /* index of the feed, for the aggregate feed */
 };
 
 struct items {
 	struct item *items;     /* array of items */
 	size_t len;             /* amount of items */
 	size_t cap;             /* available capacity */
+	int mapped;             /* scanned by a mapping, lines are read later */
+	struct arena arena;     /* memory for the lines */
+};
+
+/* bulk line reader: reads the data by chunks and finds the separators of all
+   the lines of a chunk in one pass. If `maxtabs' is set then only the first
+   `maxtabs' TABs of each line are found, for counting, which stops scanning
+   a line before its content. */
+struct linereader {
+	FILE *fp;
+	size_t maxtabs;         /* maximum TABs per line or 0 for all */
+	char *buf;              /* data of the chunks */
+	size_t size;            /* allocated size of the data */
+	size_t len;             /* length of the data */
+	size_t off;             /* offset of the next line in the data */
+	size_t *seps;           /* offsets of the TAB and newline separators */
+	size_t nseps;           /* amount of separators */
+	size_t sepcap;          /* available capacity of the separators */
+	size_t sepi;            /* index of the next separator */
+	int eof;
+};
+
+/* entry in the hash set of read URLs */
+struct urlent {
+	uint64_t hash;
+	size_t off;             /* offset + 1 of the URL in the buffer, 0 is empty */
+};
+
+/* lines of consecutive items which are lazy-loaded by one read */
+struct lazyblock {
+	size_t start;           /* index of the first item */
+	size_t n;               /* amount of items, 0 if unused */
+	char *data;             /* lines of the items */
+	unsigned long used;     /* time of last use, for LRU */
+};
+
+/* item indices in sort order and the copied sort keys of the items, the
+   lazy-loaded lines can be evicted */
+struct sortcache {
+	size_t *perm;
+	size_t n;               /* amount of items which are sorted */
+	char *keys;
+	size_t keyslen, keyscap;
+	size_t *keyoff;         /* offset of the key by item index */
+};
+
+/* rows of the items pane: indices of the sorted and filtered items */
+struct itemview {
+	size_t *idx;
+	size_t n;
+	int ok;                 /* up-to-date, else it is built again when used */
+};
+
+/* formatted date of a local day, the day is [start, start + 86400) */
+struct datememo {
+	time_t start;
+	int ok;
+	char date[10];          /* "YYYY-MM-DD", not NUL-terminated */
+};
+
+/* items of a feed which was viewed recently, see $SFEED_FEED_CACHE */
+struct feedcache {
+	struct feed *feed;
+	struct items items;
+	struct stat st;         /* state of the file of the loaded items */
+	uint64_t datahash;      /* hash of the first and last bytes */
+	off_t pos, top;         /* position in the items pane */
+	size_t size;            /* memory usage in bytes */
+	unsigned long used;     /* time of last use, for LRU */
+};
+
+/* on-disk index of a feed file, see $SFEED_INDEX_DIR */
+struct indexhdr {
+	char magic[8];          /* "sfidx01" */
+	uint64_t dev;           /* device, inode, size and modification time */
+	uint64_t ino;           /* of the feed file: it is invalid if changed */
+	uint64_t size;
+	int64_t mtime;
+	int64_t mtimensec;
+	uint64_t nitems;        /* amount of entries */
+};
+
+struct indexent {
+	int64_t offset;         /* line offset in file */
+	int64_t timestamp;      /* parsed timestamp or 0 */
+	uint64_t hash;          /* hash of the link or id field */
+	uint32_t timeok;        /* timestamp is valid */
+	uint32_t pad;
 };
 
 struct feed {
 	char         *name;     /* feed name */
+	int           namew;    /* display width of the name */
+	int           nameplain; /* name has only printable characters */
 	char         *path;     /* path to feed or NULL for stdin */
 	unsigned long totalnew; /* amount of new items per feed */
 	unsigned long total;    /* total items */
+	time_t oldestnew;       /* oldest timestamp of the items counted as new */
+	unsigned long urlsgen;  /* generation of the read URLs of the counts */
 	FILE *fp;               /* file pointer */
+	/* state of the file at the last load, to reload only changes */
+	struct stat st;
+	uint64_t datahash;      /* hash of the first and last bytes */
+	int stok;               /* state is set */
+	int counting;           /* being counted by a worker thread */
+	int reload;             /* check for changes on the next load */
+	int wd;                 /* watch of the directory of the file */
+	struct gzindex *gz;     /* checkpoints of a compressed file or NULL */
+};
+
+#ifdef SFEED_GZIP
+/* state of inflate at the end of a deflate block of a compressed file */
+struct gzpoint {
+	off_t out;              /* offset in the uncompressed data */
+	off_t in;               /* offset in the file after the block */
+	int bits;               /* unused bits of the byte before `in' */
+	unsigned char *window;  /* last GZ_WINSIZE bytes of uncompressed data */
+};
+
+struct gzreader {
+	z_stream zs;
+	int fd;
+	int ok;                 /* `zs' is initialized */
+	int raw;                /* raw deflate data: started at a checkpoint */
+	int eof;
+	int ended;              /* a member ended and no data followed yet */
+	size_t skip;            /* bytes of a member trailer to skip */
+	off_t in;               /* offset in the file of the next input */
+	off_t out;              /* offset in the uncompressed data of the output */
+	struct gzindex *gz;     /* checkpoints are added to it, can be NULL */
+	unsigned char inbuf[16384];
+	/* the uncompressed data is decompressed into the window, the data up
+	   to `winpos' from `rpos' is not read yet */
+	unsigned char window[GZ_WINSIZE];
+	size_t winpos, rpos;
+};
+
+struct gzindex {
+	struct gzpoint *points; /* ordered by offset */
+	size_t n, cap;
+	off_t size;             /* size of the uncompressed data, -1 if not known */
+	struct stat st;         /* state of the file of the checkpoints */
+	struct gzreader cur;    /* reader of the last read, for sequential reads */
+};
+#endif
+
+enum { FeedChanged = 0, FeedUnchanged, FeedAppended };
+
+/* list of feeds to count by worker threads */
+struct countjob {
+	struct feed *feeds;
+	struct feed *results;   /* counted copies of the feeds */
+	int *done;              /* result is set */
+	size_t nfeeds;
+	size_t next;            /* index of the next feed to count */
+	size_t ncount;          /* amount of feeds to count */
+	size_t nmerged;         /* amount of results merged */
+	pthread_mutex_t lock;   /* lock for `next', `results' and `done' */
+	pthread_t *threads;
+	int nthreads;
+	int running;            /* counting is in progress */
 };
 
 void alldirty(void);
 void cleanup(void);
 void draw(void);
+size_t feeds_count_merge(void);
+void feeds_count_start(struct feed *, size_t, int);
+void feeds_count_wait(void);
+void lazy_evict(struct lazyblock *);
+void views_free(int);
+void views_stale(int);
+void items_setview(void);
+void lazy_free(void);
+void feed_stream_read(struct feed *);
+void watch_read(void);
+unsigned long urls_gen(void);
+void urls_lock(int);
+void urls_unlock(void);
 int getsidebarsize(void);
+char *itemfield(struct item *, int);
 void markread(struct pane *, off_t, off_t, int);
+void marks_apply(void);
+int marks_flush(void);
 void pane_draw(struct pane *);
 void sighandler(int);
 void updategeom(void);
 void updatesidebar(void);
+void urls_addurl(const char *);
+int urls_append(const char *, size_t);
 void urls_free(void);
 int urls_isnew(const char *);
+int urls_isnewhash(uint64_t);
 void urls_read(void);
+void urls_remove(const char *);
+int urls_write(void);
 
 static struct linebar linebar;
 static struct statusbar statusbar;
@@ -175,23 +418,182 @@ static int istermsetup, needcleanup;
 
 static struct feed *feeds;
 static struct feed *curfeed;
+static struct feed *allfeed; /* aggregate feed of all items: $SFEED_ALL_FEEDS */
+/* state of the feed files of the loaded items of the aggregate feed */
+static struct stat *allstates;
+static int itemsort = SortFile; /* sort order of the items pane */
+static int itemfilter; /* filters of the items pane */
+static char *itemcategory; /* category for FilterCategory */
+/* the sorted items by their index, cached per sort order: after appending
+   items they are merged */
+static struct sortcache sortcaches[SortLast];
+static struct itemview views[SortLast][FilterLast];
+static struct itemview *curview; /* NULL: all items in file order */
+static struct items curitems; /* items of the current loaded feed */
 static size_t nfeeds; /* amount of feeds */
 static time_t comparetime;
-static char *urlfile, **urls;
-static size_t nurls;
+static char *urlfile;
+/* read URLs: open-addressing hash set over one buffer of NUL-terminated lines */
+static char *urlbuf;
+static size_t urlbuflen, urlbufsiz;
+static struct urlent *urltab;
+static size_t urltabsize, nurls; /* table size is a power of 2 */
+static struct stat urlst; /* state of the urlfile at the last read */
+static uint64_t urldatahash; /* hash of the first and last bytes of the urlfile */
+static unsigned long urlsgen; /* generation, changes when the URLs are reread */
+/* the read URLs are only changed by the main thread, the count workers read
+   them: while counting they are changed with a write lock */
+static pthread_rwlock_t urlslock = PTHREAD_RWLOCK_INITIALIZER;
+static char *indexdir; /* env variable: $SFEED_INDEX_DIR */
 
 volatile sig_atomic_t sigstate = 0;
 
 static char *plumbercmd = "xdg-open"; /* env variable: $SFEED_PLUMBER */
-static char *pipercmd = "sfeed_content"; /* env variable: $SFEED_PIPER */
+static char *pipercmd; /* env variable: $SFEED_PIPER, NULL: builtin viewer */
+/* env variable: $SFEED_HTMLCONV, HTML to text for the builtin viewer */
+static char *htmlconvcmd = "lynx -stdin -dump -underline_links -image_links "
+	"-display_charset=utf-8 -assume_charset=utf-8";
 static char *yankercmd = "xclip -r"; /* env variable: $SFEED_YANKER */
-static char *markreadcmd = "sfeed_markread read"; /* env variable: $SFEED_MARK_READ */
-static char *markunreadcmd = "sfeed_markread unread"; /* env variable: $SFEED_MARK_UNREAD */
+static char *markreadcmd; /* env variable: $SFEED_MARK_READ, NULL: builtin */
+static char *markunreadcmd; /* env variable: $SFEED_MARK_UNREAD, NULL: builtin */
+static int markdefer = 0; /* env variable: $SFEED_MARK_DEFER, in seconds */
+static char *markbuf; /* unflushed marks: 'r' or 'u' and the URL, NUL-separated */
+static size_t marklen, markcap, nmarks;
+static time_t marktime; /* time of the last unflushed mark */
 static char *cmdenv; /* env variable: $SFEED_AUTOCMD */
 static int plumberia = 0; /* env variable: $SFEED_PLUMBER_INTERACTIVE */
 static int piperia = 1; /* env variable: $SFEED_PIPER_INTERACTIVE */
 static int yankeria = 0; /* env variable: $SFEED_YANKER_INTERACTIVE */
 static int lazyload = 0; /* env variable: $SFEED_LAZYLOAD */
+static int lazyreadahead = 1; /* env variable: $SFEED_LAZYLOAD_READAHEAD */
+static struct lazyblock lazyblocks[LAZY_BLOCKS];
+static unsigned long lazyclock; /* counter for the LRU of the blocks */
+static off_t lazyprevpos; /* previous lazy-loaded item: scroll direction */
+static int usemmap = 0; /* env variable: $SFEED_MMAP */
+static sigjmp_buf mapjmp; /* return from a SIGBUS while scanning a mapping */
+static size_t feedcachemax = 0; /* env variable: $SFEED_FEED_CACHE, in bytes */
+static struct feedcache *feedcache;
+static size_t nfeedcache, feedcachesize;
+static unsigned long feedcacheclock; /* counter for the LRU of the cache */
+static struct datememo datememo[64]; /* by day, see timeformat() */
+static int countthreads = 1; /* env variable: $SFEED_THREADS */
+static int bgcount = 0; /* env variable: $SFEED_BACKGROUND_COUNT */
+static int scrolllines = 0; /* env variable: $SFEED_SCROLL_LINES */
+static struct countjob countjob = { .lock = PTHREAD_MUTEX_INITIALIZER };
+static int countpipe[2] = { -1, -1 }; /* wakes up readch() for counted feeds */
+static int sigpipe[2] = { -1, -1 }; /* wakes up readch() for signals */
+static int countsupdated; /* counts of the feeds changed, update the sidebar */
+static int countsstale; /* feeds were counted with changed read URLs */
+static int autoreload = 0; /* env variable: $SFEED_AUTORELOAD */
+static int watchfd = -1; /* watches the feed files for changes */
+static int urlwd = -1; /* watch of the directory of the urlfile */
+static const char *urlname; /* name of the urlfile in its directory */
+static time_t watchtime; /* time of the last change, 0 if nothing changed */
+static int urlschanged; /* the urlfile changed */
+static int streaming = 0; /* env variable: $SFEED_STREAM */
+static int streamfd = -1; /* stdin stream of feed data, -1 if not streaming */
+static FILE *streamspill; /* temporary file of the stream data for lazyload */
+static char *streambuf; /* incomplete line of the stream data */
+static size_t streamlen, streamcap;
+static off_t streamoffset; /* offset of the line at the start of streambuf */
+static off_t searchfrom; /* position before the search prompt */
+static int searchdir; /* direction of the search prompt */
+static struct pane *searchpane; /* pane of the shown match, NULL: none */
+static off_t searchpos; /* position of the shown match */
+static size_t searchmatch, searchtotal; /* number of the match and matches */
+
+#ifdef SFEED_STATS
+/* instrumentation of the hot paths: the amount of calls and the total time,
+   it is shown with the key I and written on exit to $SFEED_STATS_FILE */
+enum { StatLoad = 0, StatCount, StatUrls, StatLazy, StatDraw, StatSpawn,
+       StatLast };
+
+struct counter {
+	const char *name;
+	unsigned long n;
+	double ms;
+};
+
+static struct counter stats[StatLast] = {
+	[StatLoad] = { .name = "load" },
+	[StatCount] = { .name = "count" },
+	[StatUrls] = { .name = "urls" },
+	[StatLazy] = { .name = "lazy" },
+	[StatDraw] = { .name = "draw" },
+	[StatSpawn] = { .name = "spawn" }
+};
+/* bytes written to the terminal, almost all by drawing */
+static unsigned long long statsttybytes;
+static pthread_mutex_t statslock = PTHREAD_MUTEX_INITIALIZER; /* for counting */
+static int statsshow; /* show the stats in the statusbar */
+
+double
+stats_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+void
+stats_add(int s, double ms)
+{
+	pthread_mutex_lock(&statslock);
+	stats[s].n++;
+	stats[s].ms += ms;
+	pthread_mutex_unlock(&statslock);
+}
+
+/* Format the stats as one line in `buf'. */
+void
+stats_format(char *buf, size_t bufsiz)
+{
+	size_t i, len = 0;
+	int r;
+
+	pthread_mutex_lock(&statslock);
+	for (i = 0; i < StatLast && len < bufsiz; i++) {
+		r = snprintf(buf + len, bufsiz - len, "%s%s %lu/%.1fms", i ? " " : "",
+		             stats[i].name, stats[i].n, stats[i].ms);
+		if (r < 0)
+			break;
+		len += r;
+	}
+	pthread_mutex_unlock(&statslock);
+	if (len < bufsiz)
+		snprintf(buf + len, bufsiz - len, " tty %lluB/draw",
+		         stats[StatDraw].n ? statsttybytes / stats[StatDraw].n : 0);
+}
+
+void
+stats_dump(void)
+{
+	FILE *fp;
+	const char *path;
+	size_t i;
+
+	if (!(path = getenv("SFEED_STATS_FILE")) || !*path)
+		return;
+	if (!(fp = fopen(path, "w")))
+		return;
+	for (i = 0; i < StatLast; i++)
+		fprintf(fp, "%s\t%lu\t%.3f\n", stats[i].name, stats[i].n, stats[i].ms);
+	fprintf(fp, "ttybytes\t%llu\n", statsttybytes);
+	fclose(fp);
+}
+
+/* time the statement `stmt' */
+#define STATS_TIME(s, stmt) do { \
+	double stats_t_ = stats_now(); \
+	stmt; \
+	stats_add((s), stats_now() - stats_t_); \
+} while (0)
+#define STATS_TTY(n) (statsttybytes += (n))
+#else
+#define STATS_TIME(s, stmt) do { stmt; } while (0)
+#define STATS_TTY(n) ((void)0)
+#endif
 
 int
 ttywritef(const char *fmt, ...)
@@ -202,17 +604,20 @@ ttywritef(const char *fmt, ...)
 	va_start(ap, fmt);
 	n = vfprintf(stdout, fmt, ap);
 	va_end(ap);
-	fflush(stdout);
+	STATS_TTY(n > 0 ? n : 0);
 
 	return n;
 }
 
+/* Write to the buffered stdout, it is flushed when waiting for input, after
+   drawing and on cleanup(). */
 int
 ttywrite(const char *s)
 {
 	if (!s)
 		return 0; /* for tparm() returning NULL */
-	return write(1, s, strlen(s));
+	STATS_TTY(strlen(s));
+	return fputs(s, stdout);
 }
 
 /* hint for compilers and static analyzers that a function exits */
@@ -272,6 +677,54 @@ estrdup(const char *s)
 	return p;
 }
 
+/* Allocate `n' bytes from the arena, it is not initialized. */
+void *
+arena_alloc(struct arena *a, size_t n)
+{
+	struct arenablock *b;
+	size_t cap;
+
+	n = (n + sizeof(void *) - 1) & ~(sizeof(void *) - 1); /* align */
+	if (!(b = a->blocks) || b->cap - b->len < n) {
+		cap = MAX(n, ARENA_BLOCKSIZE);
+		if (!(b = malloc(sizeof(*b) + cap)))
+			die("malloc");
+		b->len = 0;
+		b->cap = cap;
+		b->next = a->blocks;
+		a->blocks = b;
+	}
+	b->len += n;
+
+	return b->data + b->len - n;
+}
+
+/* Copy a string of length `len' into the arena. */
+char *
+arena_strndup(struct arena *a, const char *s, size_t len)
+{
+	char *p;
+
+	p = arena_alloc(a, len + 1);
+	memcpy(p, s, len);
+	p[len] = '\0';
+
+	return p;
+}
+
+/* Free all allocations of the arena. */
+void
+arena_free(struct arena *a)
+{
+	struct arenablock *b, *next;
+
+	for (b = a->blocks; b; b = next) {
+		next = b->next;
+		free(b);
+	}
+	a->blocks = NULL;
+}
+
 /* wrapper for tparm which allows NULL parameter for str. */
 char *
 tparmnull(const char *str, long p1, long p2, long p3, long p4, long p5,
@@ -282,17 +735,91 @@ tparmnull(const char *str, long p1, long p2, long p3, long p4, long p5,
 	return tparm(str, p1, p2, p3, p4, p5, p6, p7, p8, p9);
 }
 
+#ifdef SFEED_SIMD
+/* Find the first byte in `h' which is the lowercase character `lc' compared
+   case-insensitively for ASCII or the NUL terminator. The data is read by
+   aligned blocks of 16 bytes: a block is never across a page boundary. */
+const char *
+strcasechrnul(const char *h, int lc)
+{
+	size_t off = (uintptr_t)h & 15;
+	const unsigned char *p = (const unsigned char *)h - off;
+#ifdef SFEED_NEON
+	uint8x16_t v, m, c = vdupq_n_u8(lc), upper;
+	uint64_t bits;
+
+	for (;; p += 16, off = 0) {
+		v = vld1q_u8(p);
+		/* mark uppercase ASCII letters and fold them to lowercase */
+		upper = vandq_u8(vcgtq_u8(v, vdupq_n_u8('A' - 1)),
+		                 vcltq_u8(v, vdupq_n_u8('Z' + 1)));
+		m = vorrq_u8(vceqq_u8(vorrq_u8(v, vandq_u8(upper, vdupq_n_u8(0x20))), c),
+		             vceqq_u8(v, vdupq_n_u8(0)));
+		/* 4 bits per byte */
+		bits = vget_lane_u64(vreinterpret_u64_u8(
+		       vshrn_n_u16(vreinterpretq_u16_u8(m), 4)), 0);
+		bits &= ~0ULL << (off * 4);
+		if (bits)
+			break;
+	}
+	for (off = 0; !(bits & 0xf); bits >>= 4)
+		off++;
+#else
+	__m128i v, m, c = _mm_set1_epi8(lc), upper;
+	unsigned int bits;
+
+	for (;; p += 16, off = 0) {
+		v = _mm_load_si128((const __m128i *)p);
+		/* mark uppercase ASCII letters and fold them to lowercase */
+		upper = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('A' - 1)),
+		                      _mm_cmplt_epi8(v, _mm_set1_epi8('Z' + 1)));
+		m = _mm_or_si128(_mm_cmpeq_epi8(_mm_or_si128(v,
+		                 _mm_and_si128(upper, _mm_set1_epi8(0x20))), c),
+		                 _mm_cmpeq_epi8(v, _mm_setzero_si128()));
+		bits = _mm_movemask_epi8(m) & (0xffffU << off);
+		if (bits)
+			break;
+	}
+	for (off = 0; !(bits & 1); bits >>= 1)
+		off++;
+#endif
+	return (const char *)p + off;
+}
+#endif
+
 /* strcasestr() included for portability */
 #undef strcasestr
 char *
 strcasestr(const char *h, const char *n)
 {
 	size_t i;
+	int lc, uc;
 
 	if (!n[0])
 		return (char *)h;
 
+	lc = tolower((unsigned char)n[0]);
+	uc = toupper((unsigned char)n[0]);
+#ifdef SFEED_SIMD
+	/* the SIMD version folds only ASCII characters */
+	if (lc >= 128 || uc >= 128 || (lc != uc && uc + 0x20 != lc))
+		goto portable;
+	for (;; ++h) {
+		/* skip to a match of the first character */
+		if (!*(h = strcasechrnul(h, lc)))
+			return NULL;
+		for (i = 1; n[i] && tolower((unsigned char)n[i]) ==
+		            tolower((unsigned char)h[i]); ++i)
+			;
+		if (n[i] == '\0')
+			return (char *)h;
+	}
+portable:
+#endif
 	for (; *h; ++h) {
+		/* optimization: skip to a match of the first character */
+		if ((unsigned char)*h != uc && tolower((unsigned char)*h) != lc)
+			continue;
 		for (i = 0; n[i] && tolower((unsigned char)n[i]) ==
 		            tolower((unsigned char)h[i]); ++i)
 			;
@@ -303,6 +830,86 @@ strcasestr(const char *h, const char *n)
 	return NULL;
 }
 
+/* Index of the lowest set bit of the non-zero `bits'. */
+unsigned int
+lowbit(uint64_t bits)
+{
+#ifdef __GNUC__
+	return __builtin_ctzll(bits);
+#else
+	unsigned int n;
+
+	for (n = 0; !(bits & 1); bits >>= 1)
+		n++;
+	return n;
+#endif
+}
+
+/* Find the TAB and newline separators in `s' from offset `i' to `len' in a
+   single pass and store their offsets in `pos'. This stops early after `max'
+   separators. Returns the amount of separators stored. */
+size_t
+sepscan(const char *s, size_t i, size_t len, size_t *pos, size_t max)
+{
+	size_t n = 0;
+#ifdef SFEED_SIMD
+	uint64_t bits;
+#ifdef SFEED_NEON
+	uint8x16_t v, m;
+
+	for (; i + 16 <= len && n < max; i += 16) {
+		v = vld1q_u8((const uint8_t *)s + i);
+		m = vorrq_u8(vceqq_u8(v, vdupq_n_u8('\t')),
+		             vceqq_u8(v, vdupq_n_u8('\n')));
+		/* 4 bits per byte, keep 1 bit per byte */
+		bits = vget_lane_u64(vreinterpret_u64_u8(
+		       vshrn_n_u16(vreinterpretq_u16_u8(m), 4)), 0) &
+		       0x1111111111111111ULL;
+		for (; bits && n < max; bits &= bits - 1)
+			pos[n++] = i + lowbit(bits) / 4;
+	}
+#else
+	__m128i v, t = _mm_set1_epi8('\t'), nl = _mm_set1_epi8('\n');
+	size_t j;
+
+	/* blocks of 64 bytes: 1 bit per byte */
+	for (; i + 64 <= len && n < max; i += 64) {
+		for (bits = 0, j = 0; j < 64; j += 16) {
+			v = _mm_loadu_si128((const __m128i *)(s + i + j));
+			v = _mm_or_si128(_mm_cmpeq_epi8(v, t), _mm_cmpeq_epi8(v, nl));
+			bits |= (uint64_t)(unsigned int)_mm_movemask_epi8(v) << j;
+		}
+		for (; bits && n < max; bits &= bits - 1)
+			pos[n++] = i + lowbit(bits);
+	}
+#endif
+#else
+	const char *e, *t, *lim;
+
+	/* the optimized memchr() of the libc, by field: the newlines are only
+	   searched up to the next TAB, so a bounded scan stops at the TAB */
+	while (i < len && n < max) {
+		t = memchr(s + i, '\t', len - i);
+		lim = t ? t : s + len;
+		while (n < max && (e = memchr(s + i, '\n', lim - (s + i)))) {
+			pos[n++] = e - s;
+			i = e - s + 1;
+		}
+		if (!t || n == max)
+			break;
+		pos[n++] = t - s;
+		i = t - s + 1;
+	}
+#endif
+#ifdef SFEED_SIMD
+	for (; i < len && n < max; i++)
+		if (s[i] == '\t' || s[i] == '\n')
+			pos[n++] = i;
+#endif
+
+	return n;
+}
+
 /* Splits fields in the line buffer by replacing TAB separators with NUL ('\0')
    terminators and assign these fields as pointers. If there are less fields
    than expected then the field is an empty string constant. */
@@ -325,6 +932,22 @@ parseline(char *line, char *fields[FieldLast])
 		fields[i] = "";
 }
 
+/* Get field `i' of the line of length `len', split by the positions of its
+   `n' TAB separators. The field is NUL-terminated in-place. If there are less
+   fields than expected then the field is an empty string constant. */
+char *
+linefield(char *line, size_t len, const size_t *tabs, size_t n, size_t i)
+{
+	size_t start;
+
+	if (i > n)
+		return "";
+	start = i ? tabs[i - 1] + 1 : 0;
+	line[i < n && i < FieldLast - 1 ? tabs[i] : len] = '\0';
+
+	return line + start;
+}
+
 /* Parse time to time_t, assumes time_t is signed, ignores fractions. */
 int
 strtotime(const char *s, time_t *t)
@@ -344,6 +967,33 @@ strtotime(const char *s, time_t *t)
 	return 0;
 }
 
+/* FNV-1a hash */
+uint64_t
+strhash(const char *s)
+{
+	uint64_t h = 0xcbf29ce484222325ULL;
+
+	for (; *s; s++) {
+		h ^= (unsigned char)*s;
+		h *= 0x100000001b3ULL;
+	}
+	return h;
+}
+
+/* FNV-1a hash of a buffer, continuing from hash `h' */
+uint64_t
+memhash(const void *buf, size_t len, uint64_t h)
+{
+	const unsigned char *s = buf;
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		h ^= s[i];
+		h *= 0x100000001b3ULL;
+	}
+	return h;
+}
+
 size_t
 colw(const char *s)
 {
@@ -374,6 +1024,36 @@ colw(const char *s)
 	return col;
 }
 
+/* Display width of the string if it has only printable characters, else -1.
+   If it is not -1 then the string can be output as-is. */
+int
+utf8width(const char *s)
+{
+	wchar_t wc;
+	size_t col = 0, i, slen;
+	int rl, w;
+
+	slen = strlen(s);
+	for (i = 0; i < slen; i += rl) {
+		rl = 1;
+		if ((unsigned char)s[i] < 32) {
+			return -1;
+		} else if ((unsigned char)s[i] >= 127) {
+			rl = mbtowc(&wc, &s[i], slen - i < 4 ? slen - i : 4);
+			if (rl < 0) {
+				mbtowc(NULL, NULL, 0); /* reset state */
+				return -1;
+			} else if ((w = wcwidth(wc)) == -1) {
+				return -1;
+			}
+			col += w;
+		} else {
+			col++; /* simple ASCII character */
+		}
+	}
+	return col;
+}
+
 /* Format `len' columns of characters. If string is shorter pad the rest
    with characters `pad`. */
 int
@@ -447,7 +1127,7 @@ void
 printutf8pad(FILE *fp, const char *s, size_t len, int pad)
 {
 	wchar_t wc;
-	size_t col = 0, i, slen;
+	size_t col = 0, i, n, slen;
 	int inc, rl, w;
 
 	if (!len)
@@ -471,27 +1151,47 @@ printutf8pad(FILE *fp, const char *s, size_t len, int pad)
 
 			if (col + w > len || (col + w == len && s[i + inc])) {
 				fputs("\xe2\x80\xa6", fp); /* ellipsis */
+				STATS_TTY(fp == stdout ? 3 : 0);
 				col++;
 				break;
 			} else if (rl < 0) {
 				fputs("\xef\xbf\xbd", fp); /* replacement */
+				STATS_TTY(fp == stdout ? 3 : 0);
 				col++;
 				continue;
 			}
 			fwrite(&s[i], 1, rl, fp);
+			STATS_TTY(fp == stdout ? rl : 0);
 			col += w;
 		} else {
+			/* optimization: write a run of simple ASCII characters
+			   which are not truncated at once */
+			for (n = 0; i + n < slen && col + n + 1 < len &&
+			     (unsigned char)s[i + n] >= 32 &&
+			     (unsigned char)s[i + n] < 127; n++)
+				;
+			if (n > 1) {
+				fwrite(&s[i], 1, n, fp);
+				STATS_TTY(fp == stdout ? n : 0);
+				col += n;
+				inc = n;
+				continue;
+			}
+
 			/* optimization: simple ASCII character */
 			if (col + 1 > len || (col + 1 == len && s[i + 1])) {
 				fputs("\xe2\x80\xa6", fp); /* ellipsis */
+				STATS_TTY(fp == stdout ? 3 : 0);
 				col++;
 				break;
 			}
 			putc(s[i], fp);
+			STATS_TTY(fp == stdout);
 			col++;
 		}
 
 	}
+	STATS_TTY(fp == stdout && col < len ? len - col : 0);
 	for (; col < len; ++col)
 		putc(pad, fp);
 }
@@ -509,6 +1209,8 @@ updatetitle(void)
 	size_t i;
 
 	for (i = 0; i < nfeeds; i++) {
+		if (&feeds[i] == allfeed)
+			continue; /* has the items of the other feeds */
 		totalnew += feeds[i].totalnew;
 		total += feeds[i].total;
 	}
@@ -610,6 +1312,8 @@ cleanup(void)
 			mousemode(0);
 	}
 
+	fflush(stdout);
+
 	/* restore terminal settings */
 	tcsetattr(0, TCSANOW, &tsave);
 
@@ -683,20 +1387,36 @@ init(void)
 	sigaction(SIGWINCH, &sa, NULL);
 }
 
+/* Prepare to start a program: if `interactive' then the tty is restored for
+   it. SIGINT is ignored while it runs, see processexit(). */
 void
-processexit(pid_t pid, int interactive)
+processstart(int interactive)
 {
-	pid_t wpid;
 	struct sigaction sa;
 
+	if (interactive)
+		cleanup();
+
 	memset(&sa, 0, sizeof(sa));
 	sigemptyset(&sa.sa_mask);
 	sa.sa_flags = SA_RESTART; /* require BSD signal semantics */
 	sa.sa_handler = SIG_IGN;
 	sigaction(SIGINT, &sa, NULL);
+}
+
+void
+processexit(pid_t pid, int interactive)
+{
+	pid_t wpid;
+	struct sigaction sa;
+
+	memset(&sa, 0, sizeof(sa));
+	sigemptyset(&sa.sa_mask);
+	sa.sa_flags = SA_RESTART; /* require BSD signal semantics */
 
 	if (interactive) {
-		while ((wpid = wait(NULL)) >= 0 && wpid != pid)
+		/* pid -1: no process was started */
+		while (pid != -1 && (wpid = wait(NULL)) >= 0 && wpid != pid)
 			;
 		init();
 		updatesidebar();
@@ -708,6 +1428,104 @@ processexit(pid_t pid, int interactive)
 	}
 }
 
+/* Start the program `argv' with stdin from `in' and stdout to `out' if they
+   are not -1. If not `interactive' then stdout and stderr are written to
+   /dev/null. posix_spawn() is used: the memory of this process is not copied.
+   Returns the pid or -1. */
+pid_t
+spawnargv(char *argv[], int in, int out, int interactive)
+{
+	extern char **environ;
+	posix_spawn_file_actions_t fa;
+	posix_spawnattr_t attr;
+	sigset_t sigdef;
+	pid_t pid;
+	int r;
+
+	posix_spawn_file_actions_init(&fa);
+	if (in != -1)
+		posix_spawn_file_actions_adddup2(&fa, in, 0);
+	if (!interactive) {
+		posix_spawn_file_actions_adddup2(&fa, devnullfd, 1);
+		posix_spawn_file_actions_adddup2(&fa, devnullfd, 2);
+	} else if (out != -1) {
+		posix_spawn_file_actions_adddup2(&fa, out, 1);
+	}
+	/* the signals which are ignored while it runs are not inherited */
+	posix_spawnattr_init(&attr);
+	sigemptyset(&sigdef);
+	sigaddset(&sigdef, SIGINT);
+	sigaddset(&sigdef, SIGPIPE);
+	posix_spawnattr_setsigdefault(&attr, &sigdef);
+	posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGDEF);
+
+	STATS_TIME(StatSpawn, r = posix_spawnp(&pid, argv[0], &fa, &attr, argv, environ));
+
+	posix_spawnattr_destroy(&attr);
+	posix_spawn_file_actions_destroy(&fa);
+
+	return r ? -1 : pid;
+}
+
+/* Start the program `cmd', see spawnargv(). The arguments are split by
+   whitespace if `cmd' has no characters which are special to the shell, so no
+   shell is started, else it is run with "sh -c". */
+pid_t
+spawncmd(const char *cmd, int in, int out, int interactive)
+{
+	pid_t pid;
+	char *argv[64], *buf, *s;
+	size_t argc = 0;
+
+	buf = estrdup(cmd);
+	if (strpbrk(buf, "\"'\\$`|&;<>()*?[]{}~#=%!\n")) {
+		argv[argc++] = "sh";
+		argv[argc++] = "-c";
+		argv[argc++] = buf;
+	} else {
+		for (s = strtok(buf, " \t"); s && argc + 1 < LEN(argv);
+		     s = strtok(NULL, " \t"))
+			argv[argc++] = s;
+	}
+	argv[argc] = NULL;
+
+	pid = argc ? spawnargv(argv, in, out, interactive) : -1;
+	free(buf);
+
+	return pid;
+}
+
+/* Open a pipe, the ends are closed on exec. */
+int
+pipecloexec(int fds[2])
+{
+	if (pipe(fds) == -1)
+		return -1;
+	fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+	fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+	return 0;
+}
+
+/* Start the program `cmd' with stdout to `out' if it is not -1 and return a
+   stream to write to its stdin, the pid is stored in `pid'. Returns NULL on
+   failure. */
+FILE *
+spawnpipe(const char *cmd, int out, int interactive, pid_t *pid)
+{
+	FILE *fp;
+	int fds[2];
+
+	if (pipecloexec(fds) == -1)
+		die("pipe");
+	*pid = spawncmd(cmd, fds[0], out, interactive);
+	close(fds[0]);
+	if (*pid == -1 || !(fp = fdopen(fds[1], "w"))) {
+		close(fds[1]);
+		return NULL;
+	}
+	return fp;
+}
+
 /* Pipe item line or item field to a program.
    If `field` is -1 then pipe the TSV line, else a specified field.
    if `interactive` is 1 then cleanup and restore the tty and wait on the
@@ -718,69 +1536,116 @@ pipeitem(const char *cmd, struct item *item, int field, int interactive)
 {
 	FILE *fp;
 	pid_t pid;
-	int i, status;
-
-	if (interactive)
-		cleanup();
-
-	switch ((pid = fork())) {
-	case -1:
-		die("fork");
-	case 0:
-		if (!interactive) {
-			dup2(devnullfd, 1);
-			dup2(devnullfd, 2);
-		}
+	int i;
 
-		errno = 0;
-		if (!(fp = popen(cmd, "w")))
-			die("popen: %s", cmd);
-		if (field == -1) {
-			for (i = 0; i < FieldLast; i++) {
-				if (i)
-					putc('\t', fp);
-				fputs(item->fields[i], fp);
-			}
-		} else {
-			fputs(item->fields[field], fp);
+	processstart(interactive);
+	if (!(fp = spawnpipe(cmd, -1, interactive, &pid))) {
+		processexit(-1, interactive);
+		return;
+	}
+	if (field == -1) {
+		for (i = 0; i < FieldLast; i++) {
+			if (i)
+				putc('\t', fp);
+			fputs(itemfield(item, i), fp);
 		}
-		putc('\n', fp);
-		status = pclose(fp);
-		status = WIFEXITED(status) ? WEXITSTATUS(status) : 127;
-		_exit(status);
-	default:
-		processexit(pid, interactive);
+	} else {
+		fputs(itemfield(item, field), fp);
 	}
+	putc('\n', fp);
+	fclose(fp);
+
+	processexit(pid, interactive);
 }
 
 void
 forkexec(char *argv[], int interactive)
 {
-	pid_t pid;
-
-	if (interactive)
-		cleanup();
+	processstart(interactive);
+	processexit(spawnargv(argv, -1, -1, interactive), interactive);
+}
 
-	switch ((pid = fork())) {
-	case -1:
-		die("fork");
-	case 0:
-		if (!interactive) {
-			dup2(devnullfd, 1);
-			dup2(devnullfd, 2);
+/* Write the escaped field `s' of a TSV line unescaped: \t, \n and \\, other
+   escaped characters are ignored. */
+void
+writeunescaped(FILE *fp, const char *s)
+{
+	const char *p;
+
+	for (; (p = strchr(s, '\\')); s = p[1] ? p + 2 : p + 1) {
+		fwrite(s, 1, p - s, fp);
+		switch (p[1]) {
+		case 't':  putc('\t', fp); break;
+		case 'n':  putc('\n', fp); break;
+		case '\\': putc('\\', fp); break;
 		}
-		if (execvp(argv[0], argv) == -1)
-			_exit(1);
-	default:
-		processexit(pid, interactive);
 	}
+	fputs(s, fp);
 }
 
-struct row *
-pane_row_get(struct pane *p, off_t pos)
+/* Builtin content viewer, like sfeed_content: the fields of the item and
+   the unescaped content are written to $PAGER. Only HTML content is piped
+   through $SFEED_HTMLCONV, other content is written directly. */
+void
+viewitem(struct item *item, int interactive)
 {
-	if (pos < 0 || pos >= p->nrows)
-		return NULL;
+	FILE *fp, *cfp = NULL;
+	const char *pager, *s;
+	pid_t pid, cpid;
+
+	if (!(pager = getenv("PAGER")) || !*pager)
+		pager = "less -R";
+
+	processstart(interactive);
+	if (!(fp = spawnpipe(pager, -1, interactive, &pid))) {
+		processexit(-1, interactive);
+		return;
+	}
+
+	fprintf(fp, "Title:     %s\n", itemfield(item, FieldTitle));
+	if (*(s = itemfield(item, FieldAuthor)))
+		fprintf(fp, "Author:    %s\n", s);
+	if (*(s = itemfield(item, FieldCategory))) {
+		fputs("Category:  ", fp);
+		for (; *s; s++) {
+			if (*s == '|')
+				fputs(", ", fp);
+			else
+				putc(*s, fp);
+		}
+		putc('\n', fp);
+	}
+	if (*(s = itemfield(item, FieldLink)))
+		fprintf(fp, "Link:      %s\n", s);
+	if (*(s = itemfield(item, FieldEnclosure)))
+		fprintf(fp, "Enclosure: %s\n", s);
+
+	if (*(s = itemfield(item, FieldContent))) {
+		fputs("\n", fp);
+		fflush(fp);
+		/* the converter writes directly to the pager */
+		if (!strcmp(itemfield(item, FieldContentType), "html") &&
+		    (cfp = spawnpipe(htmlconvcmd, fileno(fp), 1, &cpid))) {
+			writeunescaped(cfp, s);
+			putc('\n', cfp);
+			fclose(cfp);
+			while (waitpid(cpid, NULL, 0) == -1 && errno == EINTR)
+				;
+		} else {
+			writeunescaped(fp, s);
+			putc('\n', fp);
+		}
+	}
+	fclose(fp);
+
+	processexit(pid, interactive);
+}
+
+struct row *
+pane_row_get(struct pane *p, off_t pos)
+{
+	if (pos < 0 || pos >= p->nrows)
+		return NULL;
 
 	if (p->row_get)
 		return p->row_get(p, pos);
@@ -804,19 +1669,148 @@ pane_row_match(struct pane *p, struct row *row, const char *s)
 	return (strcasestr(pane_row_text(p, row), s) != NULL);
 }
 
+/* Is the pane the full width of the screen? */
+int
+pane_isfullwidth(struct pane *p)
+{
+	return p->x == 0 && p->x + p->width + 1 >= win.width;
+}
+
+/* Is the pane scrolled by lines: the terminal scroll region is the full width,
+   a pane which is not needs the left and right margins of the terminal. Else
+   the pane is scrolled by pages, redrawing it for every line is slow. */
+int
+pane_linescroll(struct pane *p)
+{
+	return scrolllines &&
+	       change_scroll_region && scroll_forward && scroll_reverse &&
+	       (pane_isfullwidth(p) || set_lr_margin);
+}
+
+/* First visible row of the pane: the start of the page of the focused row
+   or when scrolling by lines the top row. */
+off_t
+pane_top(struct pane *p)
+{
+	if (!pane_linescroll(p))
+		return p->pos - (p->pos % p->height);
+
+	/* keep the focused row visible */
+	if (p->top > p->pos)
+		p->top = p->pos;
+	else if (p->top + p->height <= p->pos)
+		p->top = p->pos - p->height + 1;
+	if (p->top < 0)
+		p->top = 0;
+
+	return p->top;
+}
+
+/* Scroll the screen rows of the pane by `n' rows and the rows drawn on it,
+   returns -1 if it cannot be done, then the pane needs to be redrawn. The
+   terminal scroll region is the full width: for a pane which is not the left
+   and right margins are set to the pane and its scrollbar. */
+int
+pane_scrollscreen(struct pane *p, off_t n)
+{
+	struct scrollbar *sb;
+	off_t i, k;
+	int full;
+
+	if (!n)
+		return 0;
+	full = pane_isfullwidth(p);
+	if (p->dirty || p->hidden || !p->height || p->ndrawn != p->height ||
+	    (n < 0 ? -n : n) >= p->height ||
+	    p->x >= win.width || p->y + p->height > win.height ||
+	    !pane_linescroll(p))
+		return -1;
+
+	/* the scrollbar of the pane is scrolled with it */
+	sb = &scrollbars[p - panes];
+	if (sb->ndrawn != p->height || sb->y != p->y)
+		sb->ndrawn = 0;
+	sb->dirty = 1;
+
+	cursorsave();
+	ttywrite(tparmnull(change_scroll_region, p->y, p->y + p->height - 1, 0, 0, 0, 0, 0, 0, 0));
+	if (!full)
+		ttywrite(tparmnull(set_lr_margin, p->x,
+		         MIN(p->x + p->width, win.width - 1),
+		         0, 0, 0, 0, 0, 0, 0));
+	if (n > 0) {
+		cursormove(p->x, p->y + p->height - 1);
+		for (i = 0; i < n; i++)
+			ttywrite(tparmnull(scroll_forward, 0, 0, 0, 0, 0, 0, 0, 0, 0));
+		memmove(p->drawn, p->drawn + n, (p->height - n) * sizeof(p->drawn[0]));
+		for (k = p->height - n; k < p->height; k++)
+			p->drawn[k] = 0;
+		if (sb->ndrawn) {
+			memmove(sb->drawn, sb->drawn + n, p->height - n);
+			memset(sb->drawn + p->height - n, 0, n);
+		}
+	} else {
+		cursormove(p->x, p->y);
+		for (i = 0; i < -n; i++)
+			ttywrite(tparmnull(scroll_reverse, 0, 0, 0, 0, 0, 0, 0, 0, 0));
+		memmove(p->drawn - n, p->drawn, (p->height + n) * sizeof(p->drawn[0]));
+		for (k = 0; k < -n; k++)
+			p->drawn[k] = 0;
+		if (sb->ndrawn) {
+			memmove(sb->drawn - n, sb->drawn, p->height + n);
+			memset(sb->drawn, 0, -n);
+		}
+	}
+	if (!full && clear_margins)
+		ttywrite(clear_margins);
+	else if (!full)
+		ttywrite(tparmnull(set_lr_margin, 0, win.width - 1,
+		         0, 0, 0, 0, 0, 0, 0));
+	ttywrite(tparmnull(change_scroll_region, 0, win.height - 1, 0, 0, 0, 0, 0, 0, 0));
+	cursorrestore();
+
+	return 0;
+}
+
 void
 pane_row_draw(struct pane *p, off_t pos, int selected)
 {
 	struct row *row;
+	char *text = NULL;
+	uint64_t h;
+	off_t y;
+	int flags;
 
-	if (p->hidden || !p->width || !p->height ||
-	    p->x >= win.width || p->y + (pos % p->height) >= win.height)
+	if (p->hidden || !p->width || !p->height)
+		return;
+	/* only visible rows */
+	y = pos - pane_top(p);
+	if (y < 0 || y >= p->height || p->x >= win.width || p->y + y >= win.height)
 		return;
 
 	row = pane_row_get(p, pos);
+	if (row) {
+		row->textw = -1;
+		text = pane_row_text(p, row);
+	}
+
+	/* only draw the row if it is changed on the screen */
+	if (p->ndrawn != p->height) {
+		p->drawn = erealloc(p->drawn, p->height * sizeof(p->drawn[0]));
+		memset(p->drawn, 0, p->height * sizeof(p->drawn[0]));
+		p->ndrawn = p->height;
+	}
+	flags = p->focused | (row && row->bold) << 1 | selected << 2 | !row << 3;
+	h = memhash(&flags, sizeof(flags), 0xcbf29ce484222325ULL);
+	if (row)
+		h = memhash(text, strlen(text), h);
+	h = h ? h : 1;
+	if (p->drawn[y] == h)
+		return;
+	p->drawn[y] = h;
 
 	cursorsave();
-	cursormove(p->x, p->y + (pos % p->height));
+	cursormove(p->x, p->y + y);
 
 	if (p->focused)
 		THEME_ITEM_FOCUS();
@@ -827,8 +1821,13 @@ pane_row_draw(struct pane *p, off_t pos, int selected)
 	if (selected)
 		THEME_ITEM_SELECTED();
 	if (row) {
-		printutf8pad(stdout, pane_row_text(p, row), p->width, ' ');
-		fflush(stdout);
+		if (row->textw != -1 && row->textw <= p->width) {
+			/* optimization: the width is known and it fits */
+			ttywrite(text);
+			ttywritef("%*s", p->width - row->textw, "");
+		} else {
+			printutf8pad(stdout, text, p->width, ' ');
+		}
 	} else {
 		ttywritef("%-*.*s", p->width, p->width, "");
 	}
@@ -840,6 +1839,8 @@ pane_row_draw(struct pane *p, off_t pos, int selected)
 void
 pane_setpos(struct pane *p, off_t pos)
 {
+	off_t i, top;
+
 	if (pos < 0)
 		pos = 0; /* clamp */
 	if (!p->nrows)
@@ -849,6 +1850,20 @@ pane_setpos(struct pane *p, off_t pos)
 	if (pos == p->pos)
 		return; /* no change */
 
+	if (pane_linescroll(p)) {
+		top = pane_top(p);
+		p->pos = pos;
+		/* scroll only the changed rows, the others are skipped */
+		if (pane_top(p) != top &&
+		    pane_scrollscreen(p, pane_top(p) - top) == -1) {
+			p->dirty = 1;
+		} else {
+			for (i = 0; i < p->height; i++)
+				pane_row_draw(p, p->top + i, p->top + i == pos);
+		}
+		return;
+	}
+
 	/* is on different scroll region? mark whole pane dirty */
 	if (((p->pos - (p->pos % p->height)) / p->height) !=
 	    ((pos - (pos % p->height)) / p->height)) {
@@ -866,6 +1881,11 @@ pane_scrollpage(struct pane *p, int pages)
 {
 	off_t pos;
 
+	if (pane_linescroll(p)) {
+		pane_setpos(p, p->pos + pages * p->height);
+		return;
+	}
+
 	if (pages < 0) {
 		pos = p->pos - (-pages * p->height);
 		pos -= (p->pos % p->height);
@@ -906,7 +1926,7 @@ pane_draw(struct pane *p)
 		return;
 
 	/* draw visible rows */
-	pos = p->pos - (p->pos % p->height);
+	pos = pane_top(p);
 	for (y = 0; y < p->height; y++)
 		pane_row_draw(p, y + pos, (y + pos) == p->pos);
 }
@@ -1031,6 +2051,7 @@ void
 scrollbar_draw(struct scrollbar *s)
 {
 	off_t y;
+	int state;
 
 	if (!s->dirty)
 		return;
@@ -1038,6 +2059,14 @@ scrollbar_draw(struct scrollbar *s)
 	if (s->hidden || !s->size || s->x >= win.width || s->y >= win.height)
 		return;
 
+	/* only draw the cells which are changed on the screen */
+	if (s->ndrawn != s->size) {
+		s->drawn = erealloc(s->drawn, s->size);
+		memset(s->drawn, 0, s->size);
+		s->ndrawn = s->size;
+	}
+	state = s->focused ? 3 : 1;
+
 	cursorsave();
 
 	/* draw bar (not tick) */
@@ -1048,6 +2077,9 @@ scrollbar_draw(struct scrollbar *s)
 	for (y = 0; y < s->size; y++) {
 		if (y >= s->tickpos && y < s->tickpos + s->ticksize)
 			continue; /* skip tick */
+		if (s->drawn[y] == state)
+			continue;
+		s->drawn[y] = state;
 		cursormove(s->x, s->y + y);
 		ttywrite(SCROLLBAR_SYMBOL_BAR);
 	}
@@ -1058,6 +2090,9 @@ scrollbar_draw(struct scrollbar *s)
 	else
 		THEME_SCROLLBAR_TICK_NORMAL();
 	for (y = s->tickpos; y < s->size && y < s->tickpos + s->ticksize; y++) {
+		if (s->drawn[y] == state + 1)
+			continue;
+		s->drawn[y] = state + 1;
 		cursormove(s->x, s->y + y);
 		ttywrite(SCROLLBAR_SYMBOL_TICK);
 	}
@@ -1070,18 +2105,53 @@ int
 readch(void)
 {
 	unsigned char b;
+	char buf[64];
 	fd_set readfds;
-	struct timeval tv;
+	struct timeval tv, *timeout;
+	time_t now;
+	int maxfd;
 
 	if (cmdenv && *cmdenv)
 		return *(cmdenv++);
 
+	fflush(stdout); /* output is written before waiting for input */
+
 	for (;;) {
 		FD_ZERO(&readfds);
 		FD_SET(0, &readfds);
-		tv.tv_sec = 0;
-		tv.tv_usec = 250000; /* 250ms */
-		switch (select(1, &readfds, NULL, NULL, &tv)) {
+		maxfd = 0;
+		if (sigpipe[0] != -1) {
+			FD_SET(sigpipe[0], &readfds);
+			maxfd = MAX(maxfd, sigpipe[0]);
+		}
+		if (countpipe[0] != -1) {
+			FD_SET(countpipe[0], &readfds);
+			maxfd = MAX(maxfd, countpipe[0]);
+		}
+		if (streamfd != -1) {
+			FD_SET(streamfd, &readfds);
+			maxfd = MAX(maxfd, streamfd);
+		}
+		if (watchfd != -1) {
+			FD_SET(watchfd, &readfds);
+			maxfd = MAX(maxfd, watchfd);
+		}
+		/* block until an event, only pending changed files and
+		   unflushed marks are waited for with a time-out */
+		timeout = NULL;
+		now = time(NULL);
+		if (watchtime) {
+			tv.tv_sec = MAX(watchtime + AUTORELOAD_DELAY - now, 0);
+			tv.tv_usec = 0;
+			timeout = &tv;
+		}
+		if (nmarks &&
+		    (!timeout || marktime + markdefer - now < tv.tv_sec)) {
+			tv.tv_sec = MAX(marktime + markdefer - now, 0);
+			tv.tv_usec = 0;
+			timeout = &tv;
+		}
+		switch (select(maxfd + 1, &readfds, NULL, NULL, timeout)) {
 		case -1:
 			if (errno != EINTR)
 				die("select");
@@ -1090,6 +2160,37 @@ readch(void)
 			return -3; /* time-out */
 		}
 
+		/* a signal was handled while not waiting */
+		if (sigpipe[0] != -1 && FD_ISSET(sigpipe[0], &readfds)) {
+			while (read(sigpipe[0], buf, sizeof(buf)) > 0)
+				;
+			return -2; /* like a signal */
+		}
+
+		/* feeds were counted in the background: merge them */
+		if (countpipe[0] != -1 && FD_ISSET(countpipe[0], &readfds)) {
+			while (read(countpipe[0], buf, sizeof(buf)) > 0)
+				;
+			if (feeds_count_merge())
+				countsupdated = 1;
+			if (countjob.running && countjob.nmerged == countjob.ncount)
+				feeds_count_wait();
+			/* a changed file is reloaded and counted later */
+			if (!countjob.running && countsstale && !watchtime) {
+				feeds_count_start(feeds, nfeeds, 1);
+				if (!countjob.nthreads)
+					feeds_count_wait();
+			}
+		}
+		/* feed data arrived from the stdin stream */
+		if (streamfd != -1 && FD_ISSET(streamfd, &readfds))
+			feed_stream_read(&feeds[0]);
+		/* feed files changed: they are reloaded after a delay */
+		if (watchfd != -1 && FD_ISSET(watchfd, &readfds))
+			watch_read();
+		if (!FD_ISSET(0, &readfds))
+			return -3; /* like a time-out */
+
 		switch (read(0, &b, 1)) {
 		case -1: die("read");
 		case 0: return EOF;
@@ -1098,8 +2199,10 @@ readch(void)
 	}
 }
 
+/* Edit a line of input, if `update' is set it is called with the input when
+   it is changed. */
 char *
-lineeditor(void)
+lineeditor(void (*update)(const char *))
 {
 	char *input = NULL;
 	size_t cap = 0, nchars = 0;
@@ -1119,12 +2222,18 @@ lineeditor(void)
 			if (!nchars)
 				continue;
 			input[--nchars] = '\0';
-			write(1, "\b \b", 3); /* back, blank, back */
+			ttywrite("\b \b"); /* back, blank, back */
+			if (update)
+				update(input);
 			continue;
 		} else if (ch >= ' ') {
 			input[nchars] = ch;
-			write(1, &input[nchars], 1);
+			putchar(input[nchars]);
 			nchars++;
+			if (update) {
+				input[nchars] = '\0';
+				update(input);
+			}
 		} else if (ch < 0) {
 			switch (sigstate) {
 			case 0:
@@ -1143,7 +2252,7 @@ lineeditor(void)
 }
 
 char *
-uiprompt(int x, int y, char *fmt, ...)
+uiprompt(int x, int y, void (*update)(const char *), char *fmt, ...)
 {
 	va_list ap;
 	char *input, buf[32];
@@ -1163,7 +2272,7 @@ uiprompt(int x, int y, char *fmt, ...)
 	cursormode(1);
 	cursormove(x + colw(buf) + 1, y);
 
-	input = lineeditor();
+	input = lineeditor(update);
 	attrmode(ATTR_RESET);
 
 	cursormode(0);
@@ -1208,7 +2317,6 @@ statusbar_draw(struct statusbar *s)
 	/* terminals without xenl (eat newline glitch) mess up scrolling when
 	   using the last cell on the last line on the screen. */
 	printutf8pad(stdout, s->text, s->width - (!eat_newline_glitch), ' ');
-	fflush(stdout);
 	attrmode(ATTR_RESET);
 	cursorrestore();
 }
@@ -1224,23 +2332,50 @@ statusbar_update(struct statusbar *s, const char *text)
 	s->dirty = 1;
 }
 
-/* Line to item, modifies and splits line in-place. */
+/* Field of an item, the line must be loaded. */
+char *
+itemfield(struct item *item, int field)
+{
+	return item->line + item->fields[field];
+}
+
+/* Field to match new items, if link is set match on link, else on id. Returns
+   NULL if the line is not loaded. */
+char *
+itemmatchnew(struct item *item)
+{
+	if (!item->line)
+		return NULL;
+	return itemfield(item, itemfield(item, FieldLink)[0] ? FieldLink : FieldId);
+}
+
+/* Line to item from the positions of the `n' TAB separators in the line of
+   length `len', modifies and splits line in-place like parseline() and parse
+   the timestamp. The fields are stored as offsets in the line, non-parsed
+   fields are the empty string at the end of the line. */
 int
-linetoitem(char *line, struct item *item)
+linetoitemseps(char *line, size_t len, const size_t *tabs, size_t n,
+               struct item *item)
 {
-	char *fields[FieldLast];
 	time_t parsedtime;
+	size_t i;
 
 	item->line = line;
-	parseline(line, fields);
-	memcpy(item->fields, fields, sizeof(fields));
-	if (urlfile)
-		item->matchnew = estrdup(fields[fields[FieldLink][0] ? FieldLink : FieldId]);
-	else
-		item->matchnew = NULL;
+	if (n > FieldLast - 1)
+		n = FieldLast - 1;
+	item->fields[0] = 0;
+	for (i = 0; i < n; i++) {
+		line[tabs[i]] = '\0';
+		item->fields[i + 1] = tabs[i] + 1;
+	}
+	for (i = n + 1; i < FieldLast; i++)
+		item->fields[i] = len;
+
+	if (indexdir || urlfile)
+		item->hash = strhash(itemmatchnew(item));
 
 	parsedtime = 0;
-	if (!strtotime(fields[FieldUnixTimestamp], &parsedtime)) {
+	if (!strtotime(itemfield(item, FieldUnixTimestamp), &parsedtime)) {
 		item->timestamp = parsedtime;
 		item->timeok = 1;
 	} else {
@@ -1251,243 +2386,1624 @@ linetoitem(char *line, struct item *item)
 	return 0;
 }
 
+/* Line to item, modifies and splits line in-place like parseline(). */
+int
+linetoitem(char *line, struct item *item)
+{
+	size_t len, tabs[FieldLast - 1];
+
+	len = strlen(line);
+	return linetoitemseps(line, len, tabs,
+	                      sepscan(line, 0, len, tabs, FieldLast - 1), item);
+}
+
 void
 feed_items_free(struct items *items)
 {
-	size_t i;
-
-	for (i = 0; i < items->len; i++) {
-		free(items->items[i].line);
-		free(items->items[i].matchnew);
+	/* the lines and fields point into the arena or the lazy-loaded blocks */
+	arena_free(&(items->arena));
+	if (items == &curitems) {
+		lazy_free();
+		views_free(0);
 	}
 	free(items->items);
 	items->items = NULL;
 	items->len = 0;
 	items->cap = 0;
+	items->mapped = 0;
 }
 
-void
-feed_items_get(struct feed *f, FILE *fp, struct items *itemsret)
+#ifdef SFEED_GZIP
+/* Reading of gzip-compressed feed files: the uncompressed data is read as a
+   stream for loading and counting. For lazyload the offsets of the items are
+   offsets in the uncompressed data: checkpoints of the state of inflate are
+   stored every GZ_SPAN bytes, so a line is decompressed from the checkpoint
+   before it and not from the start of the file. */
+
+/* Is the file `fd' gzip-compressed. */
+int
+gz_magic(int fd)
 {
-	struct item *item, *items = NULL;
-	char *line = NULL;
-	size_t cap, i, linesize = 0, nitems;
-	ssize_t linelen, n;
-	off_t offset;
+	unsigned char b[2];
 
-	cap = nitems = 0;
-	offset = 0;
-	for (i = 0; ; i++) {
-		if (i + 1 >= cap) {
-			cap = cap ? cap * 2 : 16;
-			items = erealloc(items, cap * sizeof(struct item));
-		}
-		if ((n = linelen = getline(&line, &linesize, fp)) > 0) {
-			item = &items[i];
+	return pread(fd, b, sizeof(b), 0) == 2 && b[0] == 0x1f && b[1] == 0x8b;
+}
 
-			item->offset = offset;
-			offset += linelen;
+/* Copy the last GZ_WINSIZE bytes of output of the reader to `w' in order. */
+void
+gz_window(struct gzreader *r, unsigned char *w)
+{
+	memcpy(w, r->window + r->winpos, GZ_WINSIZE - r->winpos);
+	memcpy(w + GZ_WINSIZE - r->winpos, r->window, r->winpos);
+}
 
-			if (line[linelen - 1] == '\n')
-				line[--linelen] = '\0';
+/* Start the reader at the checkpoint `p', or at the start if `p' is NULL.
+   Returns -1 on failure. */
+int
+gz_start(struct gzreader *r, struct gzpoint *p)
+{
+	unsigned char c;
 
-			if (lazyload && f->path) {
-				linetoitem(line, item);
+	if (r->ok)
+		inflateEnd(&(r->zs));
+	memset(&(r->zs), 0, sizeof(r->zs));
+	r->ok = r->eof = r->ended = r->skip = 0;
+	r->winpos = r->rpos = 0;
 
-				/* data is ignored here, will be lazy-loaded later. */
-				item->line = NULL;
-				memset(item->fields, 0, sizeof(item->fields));
-			} else {
-				linetoitem(estrdup(line), item);
-			}
+	if (!p) {
+		/* gzip header, members are decompressed one after another */
+		if (inflateInit2(&(r->zs), 15 + 16) != Z_OK)
+			return -1;
+		r->raw = 0;
+		r->in = r->out = 0;
+		r->ok = 1;
+		return 0;
+	}
 
-			nitems++;
-		}
-		if (ferror(fp))
-			die("getline: %s", f->name);
-		if (n <= 0 || feof(fp))
-			break;
+	/* raw deflate data from the block at the checkpoint */
+	if (inflateInit2(&(r->zs), -15) != Z_OK)
+		return -1;
+	r->ok = r->raw = 1;
+	r->in = p->in;
+	r->out = p->out;
+	if (p->bits) {
+		if (pread(r->fd, &c, 1, p->in - 1) != 1)
+			return -1;
+		inflatePrime(&(r->zs), p->bits, c >> (8 - p->bits));
 	}
-	itemsret->cap = cap;
-	itemsret->items = items;
-	itemsret->len = nitems;
-	free(line);
+	inflateSetDictionary(&(r->zs), p->window, GZ_WINSIZE);
+	/* the window is full: later checkpoints use it */
+	memcpy(r->window, p->window, GZ_WINSIZE);
+	r->winpos = r->rpos = GZ_WINSIZE;
+
+	return 0;
 }
 
+/* Add a checkpoint at the current position of the reader, which is at the end
+   of a deflate block. */
 void
-updatenewitems(struct feed *f)
+gz_addpoint(struct gzreader *r)
 {
-	struct pane *p;
-	struct row *row;
-	struct item *item;
-	size_t i;
+	struct gzindex *gz = r->gz;
+	struct gzpoint *p;
 
-	p = &panes[PaneItems];
-	f->totalnew = 0;
-	for (i = 0; i < p->nrows; i++) {
-		row = &(p->rows[i]); /* do not use pane_row_get */
-		item = row->data;
-		if (urlfile)
-			item->isnew = urls_isnew(item->matchnew);
-		else
-			item->isnew = (item->timeok && item->timestamp >= comparetime);
-		row->bold = item->isnew;
-		f->totalnew += item->isnew;
+	if (gz->n + 1 >= gz->cap) {
+		gz->cap = gz->cap ? gz->cap * 2 : 16;
+		gz->points = erealloc(gz->points, gz->cap * sizeof(gz->points[0]));
 	}
-	f->total = p->nrows;
+	p = &(gz->points[gz->n++]);
+	p->out = r->out;
+	p->in = r->in - r->zs.avail_in;
+	p->bits = r->zs.data_type & 7;
+	p->window = erealloc(NULL, GZ_WINSIZE);
+	gz_window(r, p->window);
 }
 
-void
-feed_load(struct feed *f, FILE *fp)
+/* Decompress more data into the window. Returns -1 on failure, the data
+   after a failure in a later member, such as trailing garbage, is ignored. */
+int
+gz_inflate(struct gzreader *r)
 {
-	/* static, reuse local buffers */
-	static struct items items;
-	struct pane *p;
-	size_t i;
+	struct gzindex *gz = r->gz;
+	ssize_t n;
+	size_t avail;
+	int ret;
 
-	feed_items_free(&items);
-	feed_items_get(f, fp, &items);
-	p = &panes[PaneItems];
-	p->pos = 0;
-	p->nrows = items.len;
-	free(p->rows);
-	p->rows = ecalloc(sizeof(p->rows[0]), items.len + 1);
-	for (i = 0; i < items.len; i++)
-		p->rows[i].data = &(items.items[i]); /* do not use pane_row_get */
+	if (r->winpos == GZ_WINSIZE)
+		r->winpos = r->rpos = 0;
 
-	updatenewitems(f);
+	if (!r->zs.avail_in) {
+		while ((n = pread(r->fd, r->inbuf, sizeof(r->inbuf), r->in)) == -1) {
+			if (errno != EINTR)
+				return -1;
+		}
+		if (!n) {
+			/* end of the file, a truncated member is also the end */
+			r->eof = 1;
+			if (gz && !r->raw && !r->skip && r->ended)
+				gz->size = r->out;
+			return 0;
+		}
+		r->in += n;
+		r->zs.next_in = r->inbuf;
+		r->zs.avail_in = n;
+	}
+	/* the trailer of a member which was read as raw deflate data */
+	if (r->skip) {
+		avail = MIN(r->skip, r->zs.avail_in);
+		r->zs.next_in += avail;
+		r->zs.avail_in -= avail;
+		r->skip -= avail;
+		return 0;
+	}
 
-	p->dirty = 1;
-}
+	r->zs.next_out = r->window + r->winpos;
+	r->zs.avail_out = avail = GZ_WINSIZE - r->winpos;
+	ret = inflate(&(r->zs), Z_BLOCK);
+	avail -= r->zs.avail_out;
+	r->winpos += avail;
+	r->out += avail;
+
+	switch (ret) {
+	case Z_OK:
+	case Z_BUF_ERROR:
+		if (avail)
+			r->ended = 0;
+		break;
+	case Z_STREAM_END:
+		/* the next member: the gzip trailer is skipped for raw data */
+		if (r->raw) {
+			r->skip = 8;
+			r->raw = 0;
+			ret = inflateReset2(&(r->zs), 15 + 16);
+		} else {
+			ret = inflateReset(&(r->zs));
+		}
+		r->ended = 1;
+		return ret == Z_OK ? 0 : -1;
+	default:
+		if (!r->ended)
+			return -1;
+		r->eof = 1;
+		if (gz && !r->raw)
+			gz->size = r->out;
+		return 0;
+	}
 
-void
-feed_count(struct feed *f, FILE *fp)
-{
-	char *fields[FieldLast];
-	char *line = NULL;
-	size_t linesize = 0;
-	ssize_t linelen;
-	time_t parsedtime;
+	if (gz && (r->zs.data_type & 128) && !(r->zs.data_type & 64) &&
+	    r->out - (gz->n ? gz->points[gz->n - 1].out : 0) >= GZ_SPAN)
+		gz_addpoint(r);
 
-	f->totalnew = f->total = 0;
-	while ((linelen = getline(&line, &linesize, fp)) > 0) {
-		if (line[linelen - 1] == '\n')
-			line[--linelen] = '\0';
-		parseline(line, fields);
+	return 0;
+}
 
-		if (urlfile) {
-			f->totalnew += urls_isnew(fields[fields[FieldLink][0] ? FieldLink : FieldId]);
-		} else {
-			parsedtime = 0;
-			if (!strtotime(fields[FieldUnixTimestamp], &parsedtime))
-				f->totalnew += (parsedtime >= comparetime);
+/* Read up to `len' bytes of the uncompressed data, returns the amount read or
+   -1 on failure. */
+ssize_t
+gz_read(struct gzreader *r, char *buf, size_t len)
+{
+	size_t have = 0, n;
+
+	while (have < len) {
+		if (r->rpos < r->winpos) {
+			n = MIN(len - have, r->winpos - r->rpos);
+			if (buf)
+				memcpy(buf + have, r->window + r->rpos, n);
+			r->rpos += n;
+			have += n;
+		} else if (r->eof) {
+			break;
+		} else if (gz_inflate(r) == -1) {
+			return have ? (ssize_t)have : -1;
 		}
-		f->total++;
 	}
-	if (ferror(fp))
-		die("getline: %s", f->name);
-	free(line);
+	return have;
 }
 
-void
-feed_setenv(struct feed *f)
+/* Offset of the next byte of the reader in the uncompressed data. */
+off_t
+gz_tell(struct gzreader *r)
 {
-	if (f && f->path)
-		setenv("SFEED_FEED_PATH", f->path, 1);
-	else
-		unsetenv("SFEED_FEED_PATH");
+	return r->out - (r->winpos - r->rpos);
 }
 
-/* Change feed, have one file open, reopen file if needed. */
-void
-feeds_set(struct feed *f)
+/* Skip the uncompressed data until offset `off'. Returns -1 on failure. */
+int
+gz_skipto(struct gzreader *r, off_t off)
 {
-	if (curfeed) {
-		if (curfeed->path && curfeed->fp) {
-			fclose(curfeed->fp);
-			curfeed->fp = NULL;
-		}
-	}
+	ssize_t n;
 
-	if (f && f->path) {
-		if (!f->fp && !(f->fp = fopen(f->path, "rb")))
-			die("fopen: %s", f->path);
+	while (gz_tell(r) < off) {
+		if ((n = gz_read(r, NULL, MIN(off - gz_tell(r), 65536))) <= 0)
+			return n == -1 ? -1 : 0;
 	}
-
-	feed_setenv(f);
-
-	curfeed = f;
+	return 0;
 }
 
 void
-feeds_load(struct feed *feeds, size_t nfeeds)
+gz_free(struct gzindex *gz)
 {
-	struct feed *f;
 	size_t i;
 
-	if ((comparetime = time(NULL)) == -1)
-		die("time");
-	/* 1 day is old news */
-	comparetime -= 86400;
-
-	for (i = 0; i < nfeeds; i++) {
-		f = &feeds[i];
+	if (!gz)
+		return;
+	for (i = 0; i < gz->n; i++)
+		free(gz->points[i].window);
+	free(gz->points);
+	if (gz->cur.ok)
+		inflateEnd(&(gz->cur.zs));
+	free(gz);
+}
 
-		if (f->path) {
-			if (f->fp) {
-				if (fseek(f->fp, 0, SEEK_SET))
-					die("fseek: %s", f->path);
-			} else {
-				if (!(f->fp = fopen(f->path, "rb")))
-					die("fopen: %s", f->path);
-			}
-		}
-		if (!f->fp) {
-			/* reading from stdin, just recount new */
-			if (f == curfeed)
-				updatenewitems(f);
-			continue;
-		}
+/* Set the checkpoints of the feed for the file `fd': the checkpoints are kept
+   if the file was not changed. */
+void
+gz_check(struct feed *f, int fd)
+{
+	struct stat st;
 
-		/* load first items, because of first selection or stdin. */
-		if (f == curfeed) {
-			feed_load(f, f->fp);
-		} else {
-			feed_count(f, f->fp);
-			if (f->path && f->fp) {
-				fclose(f->fp);
-				f->fp = NULL;
-			}
-		}
+	if (!gz_magic(fd) || fstat(fd, &st) == -1) {
+		gz_free(f->gz);
+		f->gz = NULL;
+		return;
 	}
+	if (f->gz && f->gz->st.st_dev == st.st_dev &&
+	    f->gz->st.st_ino == st.st_ino && f->gz->st.st_size == st.st_size &&
+	    f->gz->st.st_mtim.tv_sec == st.st_mtim.tv_sec &&
+	    f->gz->st.st_mtim.tv_nsec == st.st_mtim.tv_nsec)
+		return;
+	gz_free(f->gz);
+	f->gz = ecalloc(1, sizeof(*(f->gz)));
+	f->gz->st = st;
+	f->gz->size = -1;
 }
 
-/* find row position of the feed if visible, else return -1 */
-off_t
-feeds_row_get(struct pane *p, struct feed *f)
+/* Position the reader of the checkpoints at offset `off' of the uncompressed
+   data: from the closest checkpoint before it or from the current position
+   for reads which follow each other. Returns -1 on failure. */
+int
+gz_seek(struct gzindex *gz, int fd, off_t off)
 {
-	struct row *row;
-	struct feed *fr;
-	off_t pos;
+	struct gzreader *r = &(gz->cur);
+	struct gzpoint *p = NULL;
+	size_t lo, hi, mid;
+
+	for (lo = 0, hi = gz->n; lo < hi; ) {
+		mid = lo + (hi - lo) / 2;
+		if (gz->points[mid].out <= off)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo)
+		p = &(gz->points[lo - 1]);
 
-	for (pos = 0; pos < p->nrows; pos++) {
-		if (!(row = pane_row_get(p, pos)))
-			continue;
-		fr = row->data;
-		if (!strcmp(fr->name, f->name))
-			return pos;
+	r->fd = fd;
+	r->gz = gz;
+	if (!r->ok || gz_tell(r) > off || (p && gz_tell(r) < p->out)) {
+		if (gz_start(r, p) == -1)
+			return -1;
+	}
+	return gz_skipto(r, off);
+}
+
+/* Like pread(), but at offset `off' of the uncompressed data of the file `fd'
+   with the checkpoints `gz'. Data which cannot be decompressed is like the end
+   of the file: the file could be changed. */
+ssize_t
+gz_pread(struct gzindex *gz, int fd, void *buf, size_t len, off_t off)
+{
+	ssize_t n;
+
+	if (gz_seek(gz, fd, off) == -1)
+		return 0;
+	if ((n = gz_read(&(gz->cur), (char *)buf, len)) == -1)
+		return 0;
+	return n;
+}
+
+/* Size of the uncompressed data of the file `fd' with the checkpoints `gz',
+   it is decompressed once until the end if not known yet. */
+off_t
+gz_size(struct gzindex *gz, int fd)
+{
+	if (gz->size != -1)
+		return gz->size;
+	if (gz_seek(gz, fd, gz->n ? gz->points[gz->n - 1].out : 0) == -1)
+		return 0;
+	while (gz_read(&(gz->cur), NULL, 65536) > 0)
+		;
+	return gz->size != -1 ? gz->size : gz_tell(&(gz->cur));
+}
+
+ssize_t
+gz_cookieread(void *cookie, char *buf, size_t len)
+{
+	return gz_read(cookie, buf, len);
+}
+
+#ifndef __linux__
+int
+gz_funread(void *cookie, char *buf, int len)
+{
+	return gz_read(cookie, buf, len);
+}
+#endif
+
+int
+gz_cookieclose(void *cookie)
+{
+	struct gzreader *r = cookie;
+
+	if (r->ok)
+		inflateEnd(&(r->zs));
+	free(r);
+	return 0;
+}
+
+/* The uncompressed data of the feed file `fp' as a stream from the start, or
+   `fp' itself if it is not compressed. Checkpoints are added to `gz' if it is
+   set. */
+FILE *
+gz_data(FILE *fp, struct gzindex *gz)
+{
+	struct gzreader *r;
+	FILE *dfp;
+#ifdef __linux__
+	static cookie_io_functions_t io = {
+		gz_cookieread, NULL, NULL, gz_cookieclose
+	};
+#endif
+
+	if (!gz_magic(fileno(fp)))
+		return fp;
+
+	r = ecalloc(1, sizeof(*r));
+	r->fd = fileno(fp);
+	r->gz = gz;
+	if (gz_start(r, NULL) == -1)
+		die("inflateInit2");
+#ifdef __linux__
+	dfp = fopencookie(r, "rb", io);
+#else
+	dfp = funopen(r, gz_funread, NULL, NULL, gz_cookieclose);
+#endif
+	if (!dfp)
+		die("fopencookie");
+	return dfp;
+}
+#else
+#define gz_magic(fd) 0
+#define gz_check(f, fd) ((void)0)
+#define gz_pread(gz, fd, buf, len, off) ((ssize_t)-1)
+#define gz_size(gz, fd) ((off_t)0)
+#define gz_data(fp, gz) (fp)
+#endif
+
+/* Fill the header fields that identify the state of the feed file. */
+int
+feed_index_key(FILE *fp, struct indexhdr *h)
+{
+	struct stat st;
+
+	if (fstat(fileno(fp), &st) == -1 || !S_ISREG(st.st_mode))
+		return -1;
+
+	memset(h, 0, sizeof(*h));
+	memcpy(h->magic, "sfidx01", sizeof("sfidx01"));
+	h->dev = st.st_dev;
+	h->ino = st.st_ino;
+	h->size = st.st_size;
+	h->mtime = st.st_mtim.tv_sec;
+	h->mtimensec = st.st_mtim.tv_nsec;
+
+	return 0;
+}
+
+/* Path of the index of the feed file: the feed name and a hash of the
+   absolute path of the file, feeds with the same name in different
+   directories have their own index. */
+char *
+feed_index_path(struct feed *f)
+{
+	char *abs, *path;
+	size_t len;
+	uint64_t h;
+
+	abs = realpath(f->path, NULL);
+	h = strhash(abs ? abs : f->path);
+	free(abs);
+
+	len = strlen(indexdir) + strlen(f->name) +
+	      sizeof("/-0123456789abcdef.idx");
+	path = ecalloc(1, len);
+	snprintf(path, len, "%s/%s-%016llx.idx", indexdir, f->name,
+	         (unsigned long long)h);
+
+	return path;
+}
+
+/* Read the index of the feed file, returns NULL if there is no index or if
+   it is outdated. The amount of entries is stored in `nret'. */
+struct indexent *
+feed_index_read(struct feed *f, FILE *fp, size_t *nret)
+{
+	struct indexhdr h, key;
+	struct indexent *ents = NULL;
+	struct stat st;
+	FILE *ifp;
+	char *path;
+
+	if (!indexdir || !f->path || feed_index_key(fp, &key) == -1)
+		return NULL;
+
+	path = feed_index_path(f);
+	ifp = fopen(path, "rb");
+	free(path);
+	if (!ifp)
+		return NULL;
+
+	if (fread(&h, sizeof(h), 1, ifp) != 1 ||
+	    memcmp(h.magic, key.magic, sizeof(h.magic)) ||
+	    h.dev != key.dev || h.ino != key.ino || h.size != key.size ||
+	    h.mtime != key.mtime || h.mtimensec != key.mtimensec ||
+	    fstat(fileno(ifp), &st) == -1 ||
+	    (uint64_t)st.st_size != sizeof(h) + h.nitems * sizeof(ents[0]))
+		goto fail;
+
+	ents = ecalloc(h.nitems + 1, sizeof(ents[0]));
+	if (fread(ents, sizeof(ents[0]), h.nitems, ifp) != h.nitems)
+		goto fail;
+	fclose(ifp);
+
+	*nret = h.nitems;
+	return ents;
+
+fail:
+	free(ents);
+	fclose(ifp);
+	return NULL;
+}
+
+/* Write the index of the feed file atomically, failure is not fatal: the
+   index is only a cache. */
+void
+feed_index_write(struct feed *f, struct indexhdr *key, struct indexent *ents,
+                 size_t n)
+{
+	FILE *ifp;
+	char *path, *tmp;
+	size_t len;
+	int fd;
+
+	if (!indexdir || !f->path)
+		return;
+
+	path = feed_index_path(f);
+	len = strlen(path) + sizeof(".XXXXXX");
+	tmp = ecalloc(1, len);
+	snprintf(tmp, len, "%s.XXXXXX", path);
+
+	if ((fd = mkstemp(tmp)) == -1)
+		goto end;
+	if (!(ifp = fdopen(fd, "wb"))) {
+		close(fd);
+		unlink(tmp);
+		goto end;
+	}
+	key->nitems = n;
+	if (fwrite(key, sizeof(*key), 1, ifp) != 1 ||
+	    fwrite(ents, sizeof(ents[0]), n, ifp) != n ||
+	    fclose(ifp) || rename(tmp, path) == -1)
+		unlink(tmp);
+end:
+	free(tmp);
+	free(path);
+}
+
+/* Write the index from the loaded items, if it is not up-to-date already. */
+void
+feed_index_update(struct feed *f, FILE *fp, struct items *items)
+{
+	struct indexhdr key;
+	struct indexent *ents;
+	size_t i, n;
+
+	if (!indexdir || !f->path || feed_index_key(fp, &key) == -1)
+		return;
+	if ((ents = feed_index_read(f, fp, &n))) {
+		free(ents);
+		return;
+	}
+
+	ents = ecalloc(items->len + 1, sizeof(ents[0]));
+	for (i = 0; i < items->len; i++) {
+		ents[i].offset = items->items[i].offset;
+		ents[i].timestamp = items->items[i].timestamp;
+		ents[i].timeok = items->items[i].timeok;
+		ents[i].hash = items->items[i].hash;
+	}
+	feed_index_write(f, &key, ents, items->len);
+	free(ents);
+}
+
+/* Parse the timestamp and the hash of the item from the read-only `line' of
+   length `len' without splitting it: only the needed fields are scanned. */
+void
+mapitem(const char *line, size_t len, struct item *item)
+{
+	char buf[32];
+	size_t tabs[FieldId + 1], i, n, start, end;
+	time_t parsedtime;
+
+	n = sepscan(line, 0, len, tabs, indexdir || urlfile ? FieldId + 1 : 1);
+
+	end = n ? tabs[0] : len;
+	parsedtime = 0;
+	if (end < sizeof(buf)) {
+		memcpy(buf, line, end);
+		buf[end] = '\0';
+		item->timeok = !strtotime(buf, &parsedtime);
+	}
+	item->timestamp = item->timeok ? parsedtime : 0;
+
+	if (indexdir || urlfile) {
+		/* the link or else the id, see itemmatchnew() */
+		for (i = FieldLink; ; i = FieldId) {
+			start = i <= n ? tabs[i - 1] + 1 : len;
+			end = i < n ? tabs[i] : len;
+			if (start < end || i == FieldId)
+				break;
+		}
+		item->hash = memhash(line + start, end - start,
+		                     0xcbf29ce484222325ULL);
+	}
+}
+
+/* Return from a SIGBUS while the mapping of a feed file is read. */
+void
+mapbus(int signo)
+{
+	siglongjmp(mapjmp, 1);
+}
+
+/* Load the items of a feed file by mapping it read-only into memory while it
+   is scanned. The lines are not copied or split: like lazyload the lines are
+   read from the file when they are shown. The file can be truncated during
+   the scan: reading past its end raises SIGBUS and the scan is stopped.
+   Returns -1 if the file cannot be mapped, the caller should then fallback to
+   reading it. */
+int
+feed_items_map(struct feed *f, FILE *fp, struct items *items)
+{
+	struct sigaction sa, oldsa;
+	struct stat st;
+	struct item *item;
+	char *data, *end, *line, *nl;
+	size_t size;
+
+	if (fstat(fileno(fp), &st) == -1)
+		die("fstat: %s", f->path);
+	if (!S_ISREG(st.st_mode) || st.st_size < 0 ||
+	    (unsigned long long)st.st_size >= SIZE_MAX)
+		return -1;
+
+	items->items = NULL;
+	items->len = items->cap = 0;
+	size = st.st_size;
+	if (!size)
+		return 0;
+
+	data = mmap(NULL, size, PROT_READ, MAP_SHARED, fileno(fp), 0);
+	if (data == MAP_FAILED)
+		return -1;
+
+	memset(&sa, 0, sizeof(sa));
+	sigemptyset(&sa.sa_mask);
+	sa.sa_handler = mapbus;
+	sigaction(SIGBUS, &sa, &oldsa);
+	/* the items are stored in `items': the locals are not valid after
+	   the jump */
+	if (sigsetjmp(mapjmp, 1)) {
+		sigaction(SIGBUS, &oldsa, NULL);
+		munmap(data, size);
+		free(items->items);
+		items->items = NULL;
+		items->len = items->cap = 0;
+		return -1;
+	}
+
+	end = data + size;
+	for (line = data; line < end; line = nl + 1) {
+		if (items->len + 1 >= items->cap) {
+			items->cap = items->cap ? items->cap * 2 : 16;
+			items->items = erealloc(items->items,
+			                        items->cap * sizeof(*item));
+		}
+		if (!(nl = memchr(line, '\n', end - line)))
+			nl = end;
+
+		item = &(items->items[items->len++]);
+		memset(item, 0, sizeof(*item));
+		mapitem(line, nl - line, item);
+		item->offset = line - data;
+	}
+
+	sigaction(SIGBUS, &oldsa, NULL);
+	munmap(data, size);
+	items->mapped = 1;
+
+	return 0;
+}
+
+/* Read the next line. Returns the length of the line with its newline, a
+   newline is replaced by a NUL terminator. The offsets of the TAB separators
+   in the line are set in `tabs' and `ntabs'. Returns -1 at the end of the
+   data: ferror() should be checked. */
+ssize_t
+lines_get(struct linereader *r, char **line, size_t *linelen, size_t **tabs,
+          size_t *ntabs)
+{
+	char *e;
+	size_t i, j, end, n;
+
+	for (;;) {
+		if (r->maxtabs) {
+			/* find the end of the line, then only its first TABs */
+			e = NULL;
+			if (r->off < r->len)
+				e = memchr(r->buf + r->off, '\n',
+				           r->len - r->off);
+			if (e || (r->eof && r->off < r->len)) {
+				end = e ? (size_t)(e - r->buf) : r->len;
+				r->buf[end] = '\0';
+				*line = r->buf + r->off;
+				*linelen = end - r->off;
+				*tabs = r->seps;
+				*ntabs = sepscan(*line, 0, *linelen, r->seps,
+				                 r->maxtabs);
+				n = end - r->off + (e != NULL);
+				r->off = end + (e != NULL);
+				return n;
+			}
+			i = r->nseps; /* the separators are not stored */
+		} else {
+			for (i = r->sepi; i < r->nseps &&
+			     r->buf[r->seps[i]] != '\n'; i++)
+				;
+		}
+		if (i < r->nseps || (r->eof && r->off < r->len)) {
+			end = i < r->nseps ? r->seps[i] : r->len;
+			r->buf[end] = '\0';
+			/* make the offsets of the TABs relative to the line */
+			for (j = r->sepi; j < i; j++)
+				r->seps[j] -= r->off;
+			*line = r->buf + r->off;
+			*linelen = end - r->off;
+			*tabs = r->seps + r->sepi;
+			*ntabs = i - r->sepi;
+			n = end - r->off + (i < r->nseps);
+			r->off = end + (i < r->nseps);
+			r->sepi = i + (i < r->nseps);
+			return n;
+		}
+		if (r->eof)
+			return -1;
+
+		/* move the partial line to the start and read the next chunk */
+		memmove(r->buf, r->buf + r->off, r->len - r->off);
+		r->len -= r->off;
+		for (j = r->sepi; j < r->nseps; j++)
+			r->seps[j - r->sepi] = r->seps[j] - r->off;
+		r->nseps -= r->sepi;
+		r->sepi = r->off = 0;
+		if (r->size - r->len <= LINES_READSIZE) {
+			r->size = r->size ? r->size * 2 : LINES_READSIZE * 2;
+			r->buf = erealloc(r->buf, r->size);
+		}
+		if (!(n = fread(r->buf + r->len, 1, r->size - r->len - 1, r->fp)))
+			r->eof = 1;
+		i = r->len;
+		r->len += n;
+
+		if (r->maxtabs) {
+			/* room for the TABs of all fields: the caller can
+			   find more TABs in the line using sepscan() */
+			if (!r->seps) {
+				r->sepcap = MAX(r->maxtabs, FieldLast);
+				r->seps = ecalloc(r->sepcap,
+				                  sizeof(r->seps[0]));
+			}
+			continue;
+		}
+		/* find the separators of the whole chunk at once */
+		for (;; i = r->seps[r->nseps - 1] + 1) {
+			if (r->nseps == r->sepcap) {
+				r->sepcap = r->sepcap ? r->sepcap * 2 : 1024;
+				r->seps = erealloc(r->seps, r->sepcap * sizeof(r->seps[0]));
+			}
+			r->nseps += sepscan(r->buf, i, r->len, r->seps + r->nseps,
+			                    r->sepcap - r->nseps);
+			if (r->nseps < r->sepcap)
+				break;
+		}
+	}
+}
+
+void
+lines_free(struct linereader *r)
+{
+	free(r->buf);
+	free(r->seps);
+}
+
+/* Append the item of `line' without a newline at `offset' of the data, split
+   by the offsets of its `ntabs' TAB separators. If `lazy' is set the line is
+   not stored but lazy-loaded later. */
+void
+feed_items_add(struct items *items, char *line, size_t linelen, off_t offset,
+               const size_t *tabs, size_t ntabs, int lazy)
+{
+	struct item *item;
+
+	if (items->len + 1 >= items->cap) {
+		items->cap = items->cap ? items->cap * 2 : 16;
+		items->items = erealloc(items->items, items->cap * sizeof(struct item));
+	}
+	item = &items->items[items->len++];
+	memset(item, 0, sizeof(*item));
+	item->offset = offset;
+
+	if (lazy) {
+		linetoitemseps(line, linelen, tabs, ntabs, item);
+
+		/* data is ignored here, will be lazy-loaded later,
+		   the hash is used to match new items. */
+		item->line = NULL;
+		memset(item->fields, 0, sizeof(item->fields));
+	} else {
+		linetoitemseps(arena_strndup(&(items->arena), line, linelen),
+		               linelen, tabs, ntabs, item);
+	}
+}
+
+/* Read the items from the current position in the file, which is at `offset',
+   and append them. If `lazy' is set the lines are not stored. */
+void
+feed_items_append(struct feed *f, FILE *fp, off_t offset, struct items *items,
+                  int lazy)
+{
+	struct linereader r = { .fp = fp };
+	char *line;
+	size_t linelen, *tabs, ntabs;
+	ssize_t n;
+
+	while ((n = lines_get(&r, &line, &linelen, &tabs, &ntabs)) > 0) {
+		feed_items_add(items, line, linelen, offset, tabs, ntabs, lazy);
+		offset += n;
+	}
+	if (ferror(fp))
+		die("fread: %s", f->name);
+	lines_free(&r);
+}
+
+/* Get the items of the feed file without the lines, to lazy-load them. */
+void
+feed_items_getlazy(struct feed *f, FILE *fp, struct items *itemsret)
+{
+	struct item *items = NULL;
+	struct indexent *ents;
+	FILE *dfp;
+	size_t i, nitems;
+
+	gz_check(f, fileno(fp));
+
+	/* the offsets and timestamps are known from the index */
+	if ((ents = feed_index_read(f, fp, &nitems))) {
+		items = ecalloc(nitems + 1, sizeof(struct item));
+		for (i = 0; i < nitems; i++) {
+			items[i].offset = ents[i].offset;
+			items[i].timestamp = ents[i].timestamp;
+			items[i].timeok = ents[i].timeok;
+			items[i].hash = ents[i].hash;
+		}
+		free(ents);
+		itemsret->cap = nitems + 1;
+		itemsret->items = items;
+		itemsret->len = nitems;
+		return;
+	}
+
+	itemsret->items = NULL;
+	itemsret->len = itemsret->cap = 0;
+	dfp = gz_data(fp, f->gz);
+	feed_items_append(f, dfp, 0, itemsret, 1);
+	if (dfp != fp)
+		fclose(dfp);
+
+	feed_index_update(f, fp, itemsret);
+}
+
+void
+feed_items_get(struct feed *f, FILE *fp, struct items *itemsret)
+{
+	FILE *dfp;
+
+	if (usemmap && !lazyload && f->path && !gz_magic(fileno(fp)) &&
+	    feed_items_map(f, fp, itemsret) != -1) {
+		feed_index_update(f, fp, itemsret);
+		return;
+	}
+
+	if (lazyload && f->path) {
+		feed_items_getlazy(f, fp, itemsret);
+		return;
+	}
+
+	itemsret->items = NULL;
+	itemsret->len = itemsret->cap = 0;
+	dfp = f->path ? gz_data(fp, NULL) : fp;
+	feed_items_append(f, dfp, 0, itemsret, 0);
+	if (dfp != fp)
+		fclose(dfp);
+
+	feed_index_update(f, fp, itemsret);
+}
+
+/* Count the new items of the loaded items from index `from'. */
+void
+feed_countnewitems(struct feed *f, size_t from)
+{
+	struct item *item;
+	char *match;
+	size_t i;
+
+	for (i = from; i < curitems.len; i++) {
+		item = &(curitems.items[i]); /* do not use pane_row_get */
+		if (urlfile && (match = itemmatchnew(item)))
+			item->isnew = urls_isnew(match);
+		else if (urlfile)
+			item->isnew = urls_isnewhash(item->hash); /* not loaded */
+		else
+			item->isnew = (item->timeok && item->timestamp >= comparetime);
+		if (item->isnew && (!f->totalnew || item->timestamp < f->oldestnew))
+			f->oldestnew = item->timestamp;
+		f->totalnew += item->isnew;
+	}
+	f->total = curitems.len;
+	f->urlsgen = urlsgen;
+}
+
+void
+updatenewitems(struct feed *f)
+{
+	f->totalnew = 0;
+	feed_countnewitems(f, 0);
+	views_stale(FilterNew);
+}
+
+/* Read the available data from the stdin stream and append the complete lines
+   as items, the rows are updated directly. With lazyload the data is written
+   to a temporary file to read the lines from. */
+void
+feed_stream_read(struct feed *f)
+{
+	char *line, *nl, *end;
+	size_t from, n, tabs[FieldLast - 1];
+	ssize_t r;
+
+	if (streamlen + STREAM_READSIZE + 1 > streamcap) {
+		streamcap = streamlen + STREAM_READSIZE + 1;
+		streambuf = erealloc(streambuf, streamcap);
+	}
+	if ((r = read(streamfd, streambuf + streamlen, STREAM_READSIZE)) == -1) {
+		if (errno == EAGAIN || errno == EINTR)
+			return;
+		die("read: stdin");
+	}
+	if (r == 0) {
+		close(streamfd); /* EOF: an incomplete line is the last item */
+		streamfd = -1;
+	} else if (streamspill) {
+		if (fwrite(streambuf + streamlen, 1, r, streamspill) != (size_t)r ||
+		    fflush(streamspill))
+			die("write: temporary file");
+	}
+	streamlen += r;
+
+	from = curitems.len;
+	end = streambuf + streamlen;
+	for (line = streambuf; line < end; line = nl + 1) {
+		if (!(nl = memchr(line, '\n', end - line))) {
+			if (streamfd != -1)
+				break;
+			nl = end;
+		}
+		*nl = '\0';
+		feed_items_add(&curitems, line, nl - line, streamoffset, tabs,
+		               sepscan(line, 0, nl - line, tabs, FieldLast - 1),
+		               streamspill != NULL);
+		streamoffset += nl - line + 1;
+	}
+	/* keep the incomplete line */
+	n = line < end ? end - line : 0;
+	memmove(streambuf, line, n);
+	streamlen = n;
+
+	if (curitems.len != from) {
+		feed_countnewitems(f, from);
+		views_free(1);
+		items_setview();
+		countsupdated = 1;
+	}
+}
+
+uint64_t
+feed_datahash(int fd, off_t size)
+{
+	char buf[4096];
+	uint64_t h = 0xcbf29ce484222325ULL;
+	ssize_t n;
+
+	if ((n = pread(fd, buf, MIN((off_t)sizeof(buf), size), 0)) > 0)
+		h = memhash(buf, n, h);
+	if (size > (off_t)sizeof(buf) &&
+	    (n = pread(fd, buf, sizeof(buf), size - sizeof(buf))) > 0)
+		h = memhash(buf, n, h);
+	return h;
+}
+
+/* Store the state of the file to detect changes on a reload. The hash of the
+   first and last bytes is used to detect a rewrite which only grew the file. */
+void
+feed_savestate(struct feed *f, FILE *fp)
+{
+	f->stok = 0;
+	if (!f->path || fstat(fileno(fp), &(f->st)) == -1)
+		return;
+	f->datahash = feed_datahash(fileno(fp), f->st.st_size);
+	f->stok = 1;
+}
+
+/* Compare the file to its state `old' and hash of the data `oldhash' from
+   feed_datahash(). The current state is stored in `st'. */
+int
+file_state(int fd, struct stat *old, uint64_t oldhash, struct stat *st)
+{
+	char c;
+
+	if (fstat(fd, st) == -1 ||
+	    st->st_dev != old->st_dev || st->st_ino != old->st_ino ||
+	    st->st_size < old->st_size)
+		return FeedChanged;
+
+	if (st->st_size == old->st_size) {
+		if (st->st_mtim.tv_sec == old->st_mtim.tv_sec &&
+		    st->st_mtim.tv_nsec == old->st_mtim.tv_nsec)
+			return FeedUnchanged;
+		return FeedChanged;
+	}
+
+	/* grown: data was only appended if the old data is the same and the
+	   last line was complete, a compressed file is read again */
+	if (gz_magic(fd) || feed_datahash(fd, old->st_size) != oldhash)
+		return FeedChanged;
+	if (old->st_size &&
+	    (pread(fd, &c, 1, old->st_size - 1) != 1 || c != '\n'))
+		return FeedChanged;
+
+	return FeedAppended;
+}
+
+/* Compare the file to the state of the last load. */
+int
+feed_state(struct feed *f, FILE *fp)
+{
+	struct stat st;
+
+	if (!f->path || !f->stok)
+		return FeedChanged;
+	return file_state(fileno(fp), &(f->st), f->datahash, &st);
+}
+
+/* Set the rows of the item pane to the loaded items, the rows are the items
+   in the current sort order and filters: see item_index(). */
+void
+feed_setrows(struct feed *f)
+{
+	struct pane *p;
+
+	p = &panes[PaneItems];
+
+	updatenewitems(f);
+	/* items were appended: the sorted items are merged */
+	views_free(1);
+	items_setview();
+
+	p->dirty = 1;
+}
+
+void
+feed_load(struct feed *f, FILE *fp)
+{
+	feed_items_free(&curitems);
+	STATS_TIME(StatLoad, feed_items_get(f, fp, &curitems));
+	feed_savestate(f, fp);
+	panes[PaneItems].pos = 0;
+	feed_setrows(f);
+}
+
+/* Load only the items which were appended since the last load. */
+void
+feed_load_tail(struct feed *f, FILE *fp)
+{
+	if (fseek(fp, f->st.st_size, SEEK_SET))
+		die("fseek: %s", f->path);
+	STATS_TIME(StatLoad, feed_items_append(f, fp, f->st.st_size, &curitems,
+	           lazyload && f->path));
+	feed_savestate(f, fp);
+	feed_setrows(f);
+}
+
+/* Compare items of the aggregate feed: by timestamp, newest first, by the
+   order of the feeds and by their position in the file. */
+int
+allitemcmp(const void *v1, const void *v2)
+{
+	const struct item *i1 = v1, *i2 = v2;
+
+	if (i1->timestamp != i2->timestamp)
+		return i1->timestamp < i2->timestamp ? 1 : -1;
+	if (i1->feed != i2->feed)
+		return i1->feed < i2->feed ? -1 : 1;
+	return (i1->offset > i2->offset) - (i1->offset < i2->offset);
+}
+
+/* Is the next item of feed `a' before the next item of feed `b' for the merge:
+   newest first and by the order of the feeds. */
+int
+feeds_mergeless(struct item *items, size_t *pos, size_t a, size_t b)
+{
+	time_t ta = items[pos[a]].timestamp, tb = items[pos[b]].timestamp;
+
+	return ta != tb ? ta > tb : a < b;
+}
+
+/* Restore the heap order of the feeds `heap' of size `n' from index `i'. */
+void
+feeds_mergedown(size_t *heap, size_t n, size_t i, struct item *items,
+                size_t *pos)
+{
+	size_t c, t;
+
+	for (; (c = i * 2 + 1) < n; i = c) {
+		if (c + 1 < n &&
+		    feeds_mergeless(items, pos, heap[c + 1], heap[c]))
+			c++;
+		if (!feeds_mergeless(items, pos, heap[c], heap[i]))
+			break;
+		t = heap[i];
+		heap[i] = heap[c];
+		heap[c] = t;
+	}
+}
+
+/* Are the feed files of the loaded items of the aggregate feed unchanged? */
+int
+feed_all_unchanged(void)
+{
+	struct stat st;
+	size_t i;
+	int fd, state;
+
+	if (!allstates)
+		return 0;
+	for (i = 0; i < nfeeds; i++) {
+		if (!feeds[i].path)
+			continue;
+		if ((fd = open(feeds[i].path, O_RDONLY)) == -1)
+			return 0;
+		state = file_state(fd, &allstates[i], 0, &st);
+		close(fd);
+		if (state != FeedUnchanged)
+			return 0;
+	}
+	return 1;
+}
+
+/* Load the items of all feed files into the aggregate feed `af'. Only the
+   offsets of the lines are stored, they are lazy-loaded from the file of the
+   item. The items of each feed are stored as a run, which is sorted by
+   timestamp if it is not sorted already, and the runs are merged using a
+   heap. If no feed file changed since the last load then the loaded items
+   are kept. */
+void
+feed_load_all(struct feed *af)
+{
+	struct items fi, runs;
+	FILE *fp;
+	size_t i, j, k, n, nheap = 0, *heap, *pos, *end;
+
+	if (feed_all_unchanged()) {
+		feed_setrows(af);
+		return;
+	}
+	feed_items_free(&curitems);
+	free(allstates);
+	allstates = ecalloc(nfeeds, sizeof(allstates[0]));
+
+	memset(&runs, 0, sizeof(runs));
+	pos = ecalloc(nfeeds, sizeof(pos[0]));
+	end = ecalloc(nfeeds, sizeof(end[0]));
+	heap = ecalloc(nfeeds, sizeof(heap[0]));
+	for (i = 0; i < nfeeds; i++) {
+		pos[i] = end[i] = runs.len;
+		if (!feeds[i].path)
+			continue;
+		if (!(fp = fopen(feeds[i].path, "rb")))
+			die("fopen: %s", feeds[i].path);
+		if (fstat(fileno(fp), &allstates[i]) == -1)
+			die("fstat: %s", feeds[i].path);
+		memset(&fi, 0, sizeof(fi));
+		feed_items_getlazy(&feeds[i], fp, &fi);
+		fclose(fp);
+
+		n = fi.len;
+		if (runs.len + n > runs.cap) {
+			runs.cap = MAX(runs.cap * 2, runs.len + n);
+			runs.items = erealloc(runs.items,
+			                      runs.cap * sizeof(runs.items[0]));
+		}
+		for (j = 0; j < n; j++) {
+			fi.items[j].feed = i;
+			runs.items[runs.len + j] = fi.items[j];
+		}
+		feed_items_free(&fi);
+
+		/* feed files are usually sorted already */
+		for (j = 1; j < n; j++) {
+			if (allitemcmp(&(runs.items[runs.len + j - 1]),
+			               &(runs.items[runs.len + j])) > 0)
+				break;
+		}
+		if (j < n)
+			qsort(runs.items + runs.len, n,
+			      sizeof(runs.items[0]), allitemcmp);
+
+		runs.len += n;
+		end[i] = runs.len;
+		if (n)
+			heap[nheap++] = i;
+	}
+
+	curitems.items = ecalloc(runs.len + 1, sizeof(curitems.items[0]));
+	curitems.cap = runs.len + 1;
+	for (i = nheap / 2; i-- > 0; )
+		feeds_mergedown(heap, nheap, i, runs.items, pos);
+	while (nheap) {
+		k = heap[0];
+		curitems.items[curitems.len++] = runs.items[pos[k]++];
+		if (pos[k] == end[k])
+			heap[0] = heap[--nheap];
+		feeds_mergedown(heap, nheap, 0, runs.items, pos);
+	}
+
+	free(runs.items);
+	free(pos);
+	free(end);
+	free(heap);
+
+	panes[PaneItems].pos = 0;
+	feed_setrows(af);
+}
+
+void
+feed_countnew(struct feed *f, time_t t)
+{
+	if (!f->totalnew || t < f->oldestnew)
+		f->oldestnew = t;
+	f->totalnew++;
+}
+
+/* Count the items from the current position in the file, which is at
+   `offset', and add them to the totals. If `entsret' is set then the index
+   entries are also stored. */
+void
+feed_count_lines(struct feed *f, FILE *fp, off_t offset,
+                 struct indexent **entsret)
+{
+	struct indexent *ent, *ents = NULL;
+	struct linereader r = { .fp = fp, .maxtabs = FieldUnixTimestamp + 1 };
+	char *line, *link, *match;
+	size_t cap = 0, linelen, *tabs, ntabs, n = 0;
+	ssize_t len;
+	time_t parsedtime;
+	int timeok, needmatch;
+
+	/* only the timestamp and the field to match are needed */
+	needmatch = urlfile || entsret;
+	if (needmatch)
+		r.maxtabs = FieldLink + 1;
+	while ((len = lines_get(&r, &line, &linelen, &tabs, &ntabs)) > 0) {
+		match = NULL;
+		if (needmatch) {
+			link = linefield(line, linelen, tabs, ntabs, FieldLink);
+			/* only scan past the content if the id is needed */
+			if (!link[0] && ntabs == FieldLink + 1)
+				ntabs += sepscan(line, tabs[FieldLink] + 1,
+				                 linelen, tabs + ntabs,
+				                 FieldId + 1 - ntabs);
+			match = link[0] ? link :
+			        linefield(line, linelen, tabs, ntabs, FieldId);
+		}
+
+		parsedtime = 0;
+		timeok = !strtotime(linefield(line, linelen, tabs, ntabs,
+		                    FieldUnixTimestamp), &parsedtime);
+		if (urlfile) {
+			if (urls_isnew(match))
+				feed_countnew(f, parsedtime);
+		} else {
+			if (timeok && parsedtime >= comparetime)
+				feed_countnew(f, parsedtime);
+		}
+
+		if (entsret) {
+			if (n + 1 >= cap) {
+				cap = cap ? cap * 2 : 16;
+				ents = erealloc(ents, cap * sizeof(ents[0]));
+			}
+			ent = &ents[n++];
+			memset(ent, 0, sizeof(*ent));
+			ent->offset = offset;
+			ent->timestamp = parsedtime;
+			ent->timeok = timeok;
+			ent->hash = strhash(match);
+		}
+		offset += len;
+		f->total++;
+	}
+	if (ferror(fp))
+		die("fread: %s", f->name);
+	lines_free(&r);
+
+	if (entsret)
+		*entsret = ents;
+}
+
+void
+feed_count(struct feed *f, FILE *fp)
+{
+	struct indexhdr key;
+	struct indexent *ents = NULL;
+	FILE *dfp;
+	size_t i, n;
+	int writeindex;
+
+	f->totalnew = f->total = 0;
+	f->urlsgen = urls_gen();
+
+	/* count from the index if it is up-to-date */
+	if ((ents = feed_index_read(f, fp, &n))) {
+		for (i = 0; i < n; i++) {
+			if (urlfile) {
+				if (urls_isnewhash(ents[i].hash))
+					feed_countnew(f, ents[i].timestamp);
+			} else if (ents[i].timeok && ents[i].timestamp >= comparetime) {
+				feed_countnew(f, ents[i].timestamp);
+			}
+		}
+		f->total = n;
+		free(ents);
+		feed_savestate(f, fp);
+		return;
+	}
+	writeindex = indexdir && f->path && feed_index_key(fp, &key) != -1;
+
+	dfp = gz_data(fp, NULL);
+	feed_count_lines(f, dfp, 0, writeindex ? &ents : NULL);
+	if (dfp != fp)
+		fclose(dfp);
+	feed_savestate(f, fp);
+
+	if (writeindex)
+		feed_index_write(f, &key, ents, f->total);
+	free(ents);
+}
+
+/* Count only the items which were appended since the last load. */
+void
+feed_count_tail(struct feed *f, FILE *fp)
+{
+	if (fseek(fp, f->st.st_size, SEEK_SET))
+		die("fseek: %s", f->path);
+	feed_count_lines(f, fp, f->st.st_size, NULL);
+	feed_savestate(f, fp);
+}
+
+void
+feed_setenv(struct feed *f)
+{
+	if (f && f->path)
+		setenv("SFEED_FEED_PATH", f->path, 1);
+	else
+		unsetenv("SFEED_FEED_PATH");
+}
+
+/* Change feed, have one file open, reopen file if needed. */
+void
+feeds_set(struct feed *f)
+{
+	if (curfeed) {
+		if (curfeed->path && curfeed->fp) {
+			fclose(curfeed->fp);
+			curfeed->fp = NULL;
+		}
+	}
+
+	if (f && f->path) {
+		if (!f->fp && !(f->fp = fopen(f->path, "rb")))
+			die("fopen: %s", f->path);
+	}
+
+	feed_setenv(f);
+
+	/* the items of the aggregate feed are not loaded anymore */
+	if (curfeed == allfeed && f != allfeed) {
+		free(allstates);
+		allstates = NULL;
+	}
+	curfeed = f;
+}
+
+/* Count the items of a feed which is not loaded. Only the changes are read:
+   the counts of an unchanged file are still valid if no counted new item
+   became old. */
+void
+feed_recount(struct feed *f)
+{
+	FILE *fp;
+	int countsok, state;
+
+	if (!(fp = fopen(f->path, "rb")))
+		die("fopen: %s", f->path);
+
+	state = feed_state(f, fp);
+	countsok = urlfile ? f->urlsgen == urls_gen() :
+	           (!f->totalnew || f->oldestnew >= comparetime);
+	if (state == FeedUnchanged && countsok)
+		; /* nothing to do */
+	else if (state == FeedAppended && countsok)
+		STATS_TIME(StatCount, feed_count_tail(f, fp));
+	else
+		STATS_TIME(StatCount, feed_count(f, fp));
+
+	fclose(fp);
+}
+
+/* Worker for counting feeds: take the next feed from the list until all are
+   done. The feed is counted as a copy which is taken when counting is started,
+   the result is merged by the main thread. It is run by each thread and
+   optionally the main thread. */
+void *
+feeds_count_worker(void *arg)
+{
+	struct countjob *job = arg;
+	size_t i;
+
+	for (;;) {
+		pthread_mutex_lock(&(job->lock));
+		i = job->next++;
+		pthread_mutex_unlock(&(job->lock));
+		if (i >= job->nfeeds)
+			break;
+		if (!job->results[i].counting)
+			continue;
+
+		feed_recount(&(job->results[i]));
+
+		pthread_mutex_lock(&(job->lock));
+		job->done[i] = 1;
+		pthread_mutex_unlock(&(job->lock));
+
+		/* wake up the main thread, if the pipe is full it is already
+		   pending */
+		if (countpipe[1] != -1)
+			write(countpipe[1], "", 1);
+	}
+	return NULL;
+}
+
+/* Merge the counts and the file state of the counted feeds, the other fields
+   are only changed by the main thread. Returns the amount of merged feeds. */
+size_t
+feeds_count_merge(void)
+{
+	struct countjob *job = &countjob;
+	struct feed *f, *r;
+	size_t i, n = 0;
+
+	pthread_mutex_lock(&(job->lock));
+	for (i = 0; i < job->nfeeds; i++) {
+		f = &(job->feeds[i]);
+		if (!job->done[i] || !f->counting)
+			continue;
+		r = &(job->results[i]);
+		f->counting = 0;
+		/* the feed was opened while counting: it is loaded */
+		if (f == curfeed)
+			continue;
+		f->totalnew = r->totalnew;
+		f->total = r->total;
+		f->oldestnew = r->oldestnew;
+		f->urlsgen = r->urlsgen;
+		f->st = r->st;
+		f->datahash = r->datahash;
+		f->stok = r->stok;
+		/* the read URLs were changed while counting: count again */
+		if (urlfile && f->urlsgen != urlsgen) {
+			f->reload = 1;
+			countsstale = 1;
+		}
+		n++;
+	}
+	pthread_mutex_unlock(&(job->lock));
+	job->nmerged += n;
+
+	return n;
+}
+
+/* Wait until all feeds are counted and merge them. */
+void
+feeds_count_wait(void)
+{
+	struct countjob *job = &countjob;
+	char buf[64];
+	int i;
+
+	if (!job->running)
+		return;
+
+	feeds_count_worker(job); /* help counting the rest */
+	for (i = 0; i < job->nthreads; i++)
+		pthread_join(job->threads[i], NULL);
+	if (feeds_count_merge())
+		countsupdated = 1;
+
+	if (countpipe[0] != -1) {
+		while (read(countpipe[0], buf, sizeof(buf)) > 0)
+			;
+	}
+	free(job->threads);
+	free(job->results);
+	free(job->done);
+	job->threads = NULL;
+	job->results = NULL;
+	job->done = NULL;
+	job->nthreads = 0;
+	job->running = 0;
+}
+
+/* Start counting the feeds which are not loaded and are marked to reload by
+   worker threads, this is independent of the UI and the current feed. If
+   `background' is set then it is not waited: readch() is woken up and counted
+   feeds are merged. */
+void
+feeds_count_start(struct feed *feeds, size_t nfeeds, int background)
+{
+	struct countjob *job = &countjob;
+	size_t i;
+	int nthreads;
+
+	feeds_count_wait();
+
+	countsstale = 0;
+	job->feeds = feeds;
+	job->nfeeds = nfeeds;
+	job->next = job->ncount = job->nmerged = 0;
+	job->results = ecalloc(nfeeds, sizeof(job->results[0]));
+	job->done = ecalloc(nfeeds, sizeof(job->done[0]));
+	for (i = 0; i < nfeeds; i++) {
+		feeds[i].counting = &feeds[i] != curfeed && feeds[i].path &&
+		                    feeds[i].reload;
+		if (feeds[i].counting) {
+			feeds[i].reload = 0;
+			job->results[i] = feeds[i];
+		}
+		job->ncount += feeds[i].counting;
+	}
+	job->running = 1;
+
+	/* the main thread also counts, unless counting in the background */
+	nthreads = background ? MAX(countthreads, 1) : countthreads - 1;
+	if ((size_t)nthreads > job->ncount)
+		nthreads = job->ncount;
+	job->threads = ecalloc(nthreads + 1, sizeof(job->threads[0]));
+	for (job->nthreads = 0; job->nthreads < nthreads; job->nthreads++) {
+		if (pthread_create(&(job->threads[job->nthreads]), NULL,
+		                   feeds_count_worker, job))
+			break; /* use the available threads */
+	}
+}
+
+void
+feeds_load(struct feed *feeds, size_t nfeeds)
+{
+	struct feed *f;
+	int background, state;
+
+	if ((comparetime = time(NULL)) == -1)
+		die("time");
+	/* 1 day is old news */
+	comparetime -= 86400;
+
+	background = bgcount && countpipe[0] != -1;
+	feeds_count_start(feeds, nfeeds, background);
+
+	/* load first items, because of first selection or stdin. */
+	if ((f = curfeed) && f->reload && f == allfeed) {
+		f->reload = 0;
+		STATS_TIME(StatLoad, feed_load_all(f));
+	} else if (f && f->reload) {
+		f->reload = 0;
+		if (f->path) {
+			if (f->fp) {
+				if (fseek(f->fp, 0, SEEK_SET))
+					die("fseek: %s", f->path);
+			} else {
+				if (!(f->fp = fopen(f->path, "rb")))
+					die("fopen: %s", f->path);
+			}
+		}
+		if (!f->fp) {
+			/* reading from stdin, just recount new */
+			updatenewitems(f);
+		} else {
+			/* only the changes are reloaded */
+			state = feed_state(f, f->fp);
+			if (state == FeedUnchanged)
+				updatenewitems(f);
+			else if (state == FeedAppended && !curitems.mapped)
+				feed_load_tail(f, f->fp);
+			else
+				feed_load(f, f->fp);
+		}
+	}
+
+	/* no threads could be started: count in the main thread */
+	if (!background || !countjob.nthreads)
+		feeds_count_wait();
+}
+
+/* find row position of the feed if visible, else return -1 */
+off_t
+feeds_row_get(struct pane *p, struct feed *f)
+{
+	struct row *row;
+	struct feed *fr;
+	off_t pos;
+
+	for (pos = 0; pos < p->nrows; pos++) {
+		if (!(row = pane_row_get(p, pos)))
+			continue;
+		fr = row->data;
+		if (!strcmp(fr->name, f->name))
+			return pos;
 	}
 	return -1;
 }
 
+/* Reload the feeds which are marked to reload. */
 void
-feeds_reloadall(void)
+feeds_reload(void)
 {
 	struct pane *p;
 	struct feed *f = NULL;
 	struct row *row;
 	off_t pos;
 
+	feeds_count_wait();
+
 	p = &panes[PaneFeeds];
 	if ((row = pane_row_get(p, p->pos)))
 		f = row->data;
@@ -1496,7 +4012,7 @@ feeds_reloadall(void)
 	feeds_set(curfeed); /* close and reopen feed if possible */
 	urls_read();
 	feeds_load(feeds, nfeeds);
-	urls_free();
+	items_setview(); /* the new items could be changed */
 	/* restore numeric item position */
 	pane_setpos(&panes[PaneItems], pos);
 	updatesidebar();
@@ -1509,6 +4025,237 @@ feeds_reloadall(void)
 		pane_setpos(p, 0);
 }
 
+void
+feeds_reloadall(void)
+{
+	size_t i;
+
+	/* the timezone could be changed */
+	tzset();
+	memset(datememo, 0, sizeof(datememo));
+
+	for (i = 0; i < nfeeds; i++)
+		feeds[i].reload = 1;
+	feeds_reload();
+}
+
+#ifdef __linux__
+/* Watch the directory of the file `path' for files which are written or
+   moved into it, returns the watch descriptor or -1. The directory is watched
+   so a file which is replaced is still detected. */
+int
+watch_add(const char *path)
+{
+	char *dir, *p;
+	int wd;
+
+	dir = estrdup(path);
+	if ((p = strrchr(dir, '/')))
+		*(p == dir ? p + 1 : p) = '\0';
+	else
+		strcpy(dir, ".");
+	wd = inotify_add_watch(watchfd, dir, IN_CLOSE_WRITE | IN_MOVED_TO);
+	free(dir);
+
+	return wd;
+}
+#endif
+
+/* Start watching the feed files and the urlfile for changes, see
+   $SFEED_AUTORELOAD. This is only supported using inotify on Linux. */
+void
+watch_init(void)
+{
+#ifdef __linux__
+	size_t i;
+
+	if ((watchfd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) == -1)
+		return;
+	for (i = 0; i < nfeeds; i++)
+		feeds[i].wd = feeds[i].path ? watch_add(feeds[i].path) : -1;
+	if (urlfile) {
+		urlwd = watch_add(urlfile);
+		urlname = (urlname = strrchr(urlfile, '/')) ? urlname + 1 : urlfile;
+	}
+#endif
+}
+
+/* Read the changed files and mark them to reload. */
+void
+watch_read(void)
+{
+#ifdef __linux__
+	union {
+		struct inotify_event ev;
+		char buf[4096];
+	} u;
+	struct inotify_event *ev;
+	char *p;
+	size_t i;
+	ssize_t n;
+
+	while ((n = read(watchfd, u.buf, sizeof(u.buf))) > 0) {
+		for (p = u.buf; p < u.buf + n; p += sizeof(*ev) + ev->len) {
+			ev = (struct inotify_event *)p;
+			if (ev->mask & IN_Q_OVERFLOW) {
+				/* events were lost: check all files */
+				for (i = 0; i < nfeeds; i++)
+					feeds[i].reload = 1;
+				urlschanged = 1;
+				watchtime = time(NULL);
+				continue;
+			}
+			if (!ev->len)
+				continue;
+			for (i = 0; i < nfeeds; i++) {
+				if (feeds[i].wd == ev->wd && !strcmp(feeds[i].name, ev->name)) {
+					feeds[i].reload = 1;
+					watchtime = time(NULL);
+				}
+			}
+			if (urlname && urlwd == ev->wd && !strcmp(urlname, ev->name)) {
+				urlschanged = 1;
+				watchtime = time(NULL);
+			}
+		}
+	}
+#endif
+}
+
+/* Changes are pending and no changes happened for a while: a burst of
+   changes, such as by sfeed_update, is reloaded at once. */
+int
+watch_ready(void)
+{
+	return watchtime && time(NULL) - watchtime >= AUTORELOAD_DELAY;
+}
+
+/* Reload only the changed feeds, or all feeds if the read URLs changed. */
+void
+feeds_reloadchanged(void)
+{
+	unsigned long gen;
+	size_t i;
+
+	watchtime = 0;
+	if (urlschanged) {
+		urlschanged = 0;
+		feeds_count_wait();
+		gen = urlsgen;
+		urls_read();
+		if (urlsgen != gen) {
+			for (i = 0; i < nfeeds; i++)
+				feeds[i].reload = 1;
+		}
+	}
+	for (i = 0; i < nfeeds; i++) {
+		if (feeds[i].reload) {
+			if (allfeed)
+				allfeed->reload = 1; /* has the items of the feed */
+			feeds_reload();
+			break;
+		}
+	}
+}
+
+/* Memory usage of the items in bytes. */
+size_t
+feed_items_size(struct items *items)
+{
+	struct arenablock *b;
+	size_t size;
+
+	size = items->cap * sizeof(items->items[0]);
+	for (b = items->arena.blocks; b; b = b->next)
+		size += sizeof(*b) + b->cap;
+	return size;
+}
+
+/* Keep the loaded items of the current feed `f' in the cache, the least
+   recently used feeds are removed to stay within the memory budget. */
+void
+feed_cache_put(struct feed *f)
+{
+	struct feedcache *e;
+	size_t i, lru;
+
+	if (!feedcachemax || !f || !f->path || !f->stok || !curitems.items)
+		return;
+
+	/* the lazy-loaded lines and the sorted items are not kept */
+	for (i = 0; i < LEN(lazyblocks); i++) {
+		if (lazyblocks[i].n)
+			lazy_evict(&lazyblocks[i]);
+	}
+	views_free(0);
+
+	feedcache = erealloc(feedcache, (nfeedcache + 1) * sizeof(feedcache[0]));
+	e = &feedcache[nfeedcache++];
+	e->feed = f;
+	e->items = curitems;
+	e->st = f->st;
+	e->datahash = f->datahash;
+	e->pos = panes[PaneItems].pos;
+	e->top = panes[PaneItems].top;
+	e->size = feed_items_size(&curitems);
+	e->used = ++feedcacheclock;
+	feedcachesize += e->size;
+	memset(&curitems, 0, sizeof(curitems));
+
+	while (nfeedcache && feedcachesize > feedcachemax) {
+		for (i = lru = 0; i < nfeedcache; i++) {
+			if (feedcache[i].used < feedcache[lru].used)
+				lru = i;
+		}
+		feedcachesize -= feedcache[lru].size;
+		feed_items_free(&(feedcache[lru].items));
+		feedcache[lru] = feedcache[--nfeedcache];
+	}
+}
+
+/* Load the items of feed `f' from the cache, they are validated by the state
+   of the file and appended items are read. Returns 0 if it is not cached. */
+int
+feed_cache_get(struct feed *f)
+{
+	struct feedcache e;
+	struct stat st;
+	size_t i;
+	int state;
+
+	for (i = 0; i < nfeedcache; i++) {
+		if (feedcache[i].feed == f)
+			break;
+	}
+	if (i == nfeedcache)
+		return 0;
+	e = feedcache[i];
+	feedcache[i] = feedcache[--nfeedcache];
+	feedcachesize -= e.size;
+
+	feed_items_free(&curitems);
+	curitems = e.items;
+
+	state = file_state(fileno(f->fp), &(e.st), e.datahash, &st);
+	if (state == FeedChanged || (state == FeedAppended && curitems.mapped)) {
+		feed_load(f, f->fp);
+		return 1;
+	}
+	/* the state of the feed can be changed by counting it */
+	f->st = e.st;
+	f->datahash = e.datahash;
+	f->stok = 1;
+	if (state == FeedAppended)
+		feed_load_tail(f, f->fp);
+	else
+		feed_setrows(f);
+
+	panes[PaneItems].pos = MIN(e.pos, MAX(panes[PaneItems].nrows - 1, 0));
+	panes[PaneItems].top = e.top;
+
+	return 1;
+}
+
 void
 feed_open_selected(struct pane *p)
 {
@@ -1518,11 +4265,15 @@ feed_open_selected(struct pane *p)
 	if (!(row = pane_row_get(p, p->pos)))
 		return;
 	f = row->data;
+	marks_flush();
+	if (f != curfeed)
+		feed_cache_put(curfeed);
 	feeds_set(f);
 	urls_read();
-	if (f->fp)
+	if (f == allfeed)
+		STATS_TIME(StatLoad, feed_load_all(f));
+	else if (f->fp && !feed_cache_get(f))
 		feed_load(f, f->fp);
-	urls_free();
 	/* redraw row: counts could be changed */
 	updatesidebar();
 	updatetitle();
@@ -1543,7 +4294,7 @@ feed_plumb_selected_item(struct pane *p, int field)
 		return;
 	item = row->data;
 	markread(p, p->pos, p->pos, 1);
-	forkexec((char *[]) { plumbercmd, item->fields[field], NULL }, plumberia);
+	forkexec((char *[]) { plumbercmd, itemfield(item, field), NULL }, plumberia);
 }
 
 void
@@ -1556,7 +4307,10 @@ feed_pipe_selected_item(struct pane *p)
 		return;
 	item = row->data;
 	markread(p, p->pos, p->pos, 1);
-	pipeitem(pipercmd, item, -1, piperia);
+	if (pipercmd)
+		pipeitem(pipercmd, item, -1, piperia);
+	else
+		viewitem(item, piperia);
 }
 
 void
@@ -1585,7 +4339,7 @@ getsidebarsizedefault(void)
 			feed = &feeds[i];
 			len = snprintf(NULL, 0, " (%lu/%lu)",
 			               feed->totalnew, feed->total) +
-				       colw(feed->name);
+				       feed->namew;
 			if (len > size)
 				size = len;
 
@@ -1651,6 +4405,17 @@ updatesidebar(void)
 	if (!p->rows)
 		p->rows = ecalloc(sizeof(p->rows[0]), nfeeds + 1);
 
+	/* the counts of the aggregate feed are of all feeds */
+	if (allfeed) {
+		allfeed->totalnew = allfeed->total = 0;
+		for (i = 0; i < nfeeds; i++) {
+			if (!feeds[i].path)
+				continue;
+			allfeed->totalnew += feeds[i].totalnew;
+			allfeed->total += feeds[i].total;
+		}
+	}
+
 	switch (layout) {
 	case LayoutVertical:
 		oldvalue = p->width;
@@ -1693,6 +4458,8 @@ updatesidebar(void)
 void
 sighandler(int signo)
 {
+	int saved_errno;
+
 	switch (signo) {
 	case SIGHUP:
 	case SIGINT:
@@ -1701,6 +4468,11 @@ sighandler(int signo)
 		/* SIGTERM is more important, do not override it */
 		if (sigstate != SIGTERM)
 			sigstate = signo;
+		/* wake up readch(), also if the signal arrived before select() */
+		saved_errno = errno;
+		if (sigpipe[1] != -1)
+			write(sigpipe[1], "", 1);
+		errno = saved_errno;
 		break;
 	}
 }
@@ -1711,6 +4483,11 @@ alldirty(void)
 	win.dirty = 1;
 	panes[PaneFeeds].dirty = 1;
 	panes[PaneItems].dirty = 1;
+	/* the screen is redrawn: forget the drawn rows */
+	panes[PaneFeeds].ndrawn = 0;
+	panes[PaneItems].ndrawn = 0;
+	scrollbars[PaneFeeds].ndrawn = 0;
+	scrollbars[PaneItems].ndrawn = 0;
 	scrollbars[PaneFeeds].dirty = 1;
 	scrollbars[PaneItems].dirty = 1;
 	linebar.dirty = 1;
@@ -1722,6 +4499,8 @@ draw(void)
 {
 	struct row *row;
 	struct item *item;
+	const char *text;
+	char buf[1024], info[64], mbuf[sizeof(buf) + sizeof(info)];
 	size_t i;
 
 	if (win.dirty)
@@ -1734,7 +4513,7 @@ draw(void)
 		/* each pane has a scrollbar */
 		scrollbar_setfocus(&scrollbars[i], i == selpane);
 		scrollbar_update(&scrollbars[i],
-		                 panes[i].pos - (panes[i].pos % panes[i].height),
+		                 pane_top(&panes[i]),
 		                 panes[i].nrows, panes[i].height);
 		scrollbar_draw(&scrollbars[i]);
 	}
@@ -1744,11 +4523,43 @@ draw(void)
 	/* if item selection text changed then update the status text */
 	if ((row = pane_row_get(&panes[PaneItems], panes[PaneItems].pos))) {
 		item = row->data;
-		statusbar_update(&statusbar, item->fields[FieldLink]);
+		text = itemfield(item, FieldLink);
 	} else {
-		statusbar_update(&statusbar, "");
+		text = "";
+	}
+	/* show the sort order and filters of the items */
+	if (itemsort != SortFile || itemfilter) {
+		snprintf(buf, sizeof(buf), "[%s%s%s%s%s] %s", sortnames[itemsort],
+		         itemfilter & FilterNew ? ",new" : "",
+		         itemfilter & FilterEnclosure ? ",enclosure" : "",
+		         itemfilter & FilterCategory ? ",category:" : "",
+		         itemfilter & FilterCategory ? itemcategory : "", text);
+		text = buf;
 	}
+	/* show the number of the selected search match and the amount of
+	   unflushed marks */
+	info[0] = '\0';
+	if (searchpane && searchpane == &panes[selpane] &&
+	    searchpane->pos == searchpos)
+		snprintf(info, sizeof(info), "[match %zu/%zu] ",
+		         searchmatch, searchtotal);
+	if (nmarks)
+		snprintf(info + strlen(info), sizeof(info) - strlen(info),
+		         "[%zu unsaved] ", nmarks);
+	if (info[0]) {
+		snprintf(mbuf, sizeof(mbuf), "%s%s", info, text);
+		text = mbuf;
+	}
+#ifdef SFEED_STATS
+	if (statsshow) {
+		stats_format(buf, sizeof(buf));
+		text = buf;
+	}
+#endif
+	statusbar_update(&statusbar, text);
 	statusbar_draw(&statusbar);
+
+	fflush(stdout); /* write the whole frame at once */
 }
 
 void
@@ -1792,7 +4603,7 @@ mousereport(int button, int release, int keymask, int x, int y)
 		changedpane = (selpane != i);
 		selpane = i;
 		/* relative position on screen */
-		pos = y - p->y + p->pos - (p->pos % p->height);
+		pos = y - p->y + pane_top(p);
 		dblclick = (pos == p->pos); /* clicking the same row twice */
 
 		switch (button) {
@@ -1836,255 +4647,1435 @@ feed_row_format(struct pane *p, struct row *row)
 	feed = row->data;
 
 	/* align counts to the right and pad the rest with spaces */
-	len = snprintf(counts, sizeof(counts), "(%lu/%lu)",
-	               feed->totalnew, feed->total);
+	if (feed->counting)
+		len = snprintf(counts, sizeof(counts), "(-/-)");
+	else
+		len = snprintf(counts, sizeof(counts), "(%lu/%lu)",
+		               feed->totalnew, feed->total);
 	if (len > p->width)
 		w = p->width;
 	else
 		w = p->width - len;
 
-	needsize = (w + 1) * 4;
-	if (needsize > bufwsize) {
-		bufw = erealloc(bufw, needsize);
-		bufwsize = needsize;
+	needsize = (w + 1) * 4;
+	if (needsize > bufwsize) {
+		bufw = erealloc(bufw, needsize);
+		bufwsize = needsize;
+	}
+
+	needsize = bufwsize + sizeof(counts) + 1;
+	if (needsize > textsize) {
+		text = erealloc(text, needsize);
+		textsize = needsize;
+	}
+
+	if (feed->nameplain && feed->namew <= w &&
+	    strlen(feed->name) + w < bufwsize) {
+		/* optimization: the width is known and it fits */
+		snprintf(text, textsize, "%s%*s%s", feed->name,
+		         w - feed->namew, "", counts);
+		row->textw = w + len;
+	} else if (utf8pad(bufw, bufwsize, feed->name, w, ' ') != -1) {
+		snprintf(text, textsize, "%s%s", bufw, counts);
+	} else {
+		text[0] = '\0';
+	}
+
+	return text;
+}
+
+int
+feed_row_match(struct pane *p, struct row *row, const char *s)
+{
+	struct feed *feed;
+
+	feed = row->data;
+
+	return (strcasestr(feed->name, s) != NULL);
+}
+
+/* Search the rows from `pos' in the direction `dir' (1 is forward, -1 is
+   backward), returns the position of the first match or -1. */
+off_t
+pane_search(struct pane *p, off_t pos, const char *s, int dir)
+{
+	struct row *row;
+
+	for (; pos >= 0 && pos < p->nrows; pos += dir) {
+		if ((row = pane_row_get(p, pos)) && pane_row_match(p, row, s))
+			return pos;
+	}
+	return -1;
+}
+
+/* Count the matches of the search in the pane for the statusbar, if the rows
+   are in memory: the lazy-loaded lines are not all read for it. */
+void
+search_count(struct pane *p, off_t pos, const char *s)
+{
+	struct row *row;
+	off_t i;
+
+	searchpane = NULL;
+	if (p == &panes[PaneItems] &&
+	    (lazyload || curfeed == allfeed || curitems.mapped))
+		return;
+
+	searchmatch = searchtotal = 0;
+	for (i = 0; i < p->nrows; i++) {
+		if ((row = pane_row_get(p, i)) && pane_row_match(p, row, s)) {
+			searchtotal++;
+			if (i <= pos)
+				searchmatch++;
+		}
+	}
+	searchpane = p;
+	searchpos = pos;
+}
+
+/* Search as you type: select the first match from the position before the
+   prompt or else this position. */
+void
+search_update(const char *s)
+{
+	struct pane *p;
+	off_t pos = -1;
+
+	p = &panes[selpane];
+	if (!p->nrows)
+		return;
+	if (*s)
+		pos = pane_search(p, searchfrom + searchdir, s, searchdir);
+	pane_setpos(p, pos != -1 ? pos : searchfrom);
+
+	/* draw the pane, but not the statusbar with the prompt */
+	pane_draw(p);
+	scrollbar_update(&scrollbars[selpane], pane_top(p), p->nrows, p->height);
+	scrollbar_draw(&scrollbars[selpane]);
+	THEME_INPUT_NORMAL();
+}
+
+/* Unload the lines of a lazy-loaded block. */
+void
+lazy_evict(struct lazyblock *b)
+{
+	size_t i;
+
+	for (i = b->start; i < b->start + b->n && i < curitems.len; i++) {
+		curitems.items[i].line = NULL;
+		memset(curitems.items[i].fields, 0, sizeof(curitems.items[i].fields));
+	}
+	free(b->data);
+	b->data = NULL;
+	b->n = 0;
+}
+
+/* Unload all lazy-loaded blocks, the items are freed or reloaded. */
+void
+lazy_free(void)
+{
+	size_t i;
+
+	for (i = 0; i < LEN(lazyblocks); i++) {
+		free(lazyblocks[i].data);
+		lazyblocks[i].data = NULL;
+		lazyblocks[i].n = 0;
+	}
+}
+
+/* Compare the items at index `i1' and `i2' by their feed and position. */
+int
+lazy_itemcmp(size_t i1, size_t i2)
+{
+	struct item *a = &(curitems.items[i1]), *b = &(curitems.items[i2]);
+
+	if (a->feed != b->feed)
+		return a->feed < b->feed ? -1 : 1;
+	return (a->offset > b->offset) - (a->offset < b->offset);
+}
+
+/* Load the block `b' of items from index `start' of the aggregate feed. The
+   lines are read from the files of the items, sorted by file and position so
+   each file is opened once. */
+int
+lazy_load_feeds(struct lazyblock *b, size_t start)
+{
+	struct item *item;
+	size_t idx[LAZY_BLOCKITEMS], lineoff[LAZY_BLOCKITEMS];
+	size_t cap = 0, chunk, datalen = 0, i, j, linelen, n;
+	ssize_t r;
+	char *data = NULL, *nl;
+	int fd = -1, feed = -1, found;
+
+	n = MIN(LAZY_BLOCKITEMS, curitems.len - start);
+	for (i = 0; i < n; i++) {
+		for (j = i; j > 0 && lazy_itemcmp(idx[j - 1], start + i) > 0; j--)
+			idx[j] = idx[j - 1];
+		idx[j] = start + i;
+	}
+
+	for (i = 0; i < n; i++) {
+		item = &(curitems.items[idx[i]]);
+		lineoff[idx[i] - start] = (size_t)-1;
+		if ((int)item->feed != feed) {
+			if (fd != -1)
+				close(fd);
+			feed = item->feed;
+			fd = open(feeds[feed].path, O_RDONLY);
+		}
+		if (fd == -1)
+			continue;
+
+		/* the length of the line is not known: read until a newline */
+		found = 0;
+		for (linelen = 0, chunk = 1024; ; chunk *= 2) {
+			if (datalen + linelen + chunk + 1 > cap) {
+				cap = MAX(cap * 2, datalen + linelen + chunk + 1);
+				data = erealloc(data, cap);
+			}
+			if ((r = feeds[feed].gz ?
+			     gz_pread(feeds[feed].gz, fd, data + datalen + linelen,
+			              chunk, item->offset + linelen) :
+			     pread(fd, data + datalen + linelen, chunk,
+			           item->offset + linelen)) == -1) {
+				if (errno == EINTR)
+					continue;
+				die("pread: %s", feeds[feed].path);
+			}
+			if (r == 0)
+				break;
+			if ((nl = memchr(data + datalen + linelen, '\n', r))) {
+				linelen = nl - (data + datalen);
+				found = 1;
+				break;
+			}
+			linelen += r;
+		}
+		if (!found && !linelen)
+			continue; /* truncated: the line is not available */
+		data[datalen + linelen] = '\0';
+		lineoff[idx[i] - start] = datalen;
+		datalen += linelen + 1;
+	}
+	if (fd != -1)
+		close(fd);
+
+	b->data = data;
+	b->start = start;
+	b->n = n;
+	b->used = ++lazyclock;
+	for (i = 0; i < n; i++) {
+		if (lineoff[i] != (size_t)-1)
+			linetoitem(data + lineoff[i], &(curitems.items[start + i]));
+	}
+
+	return 0;
+}
+
+/* Read the block `b' of lines of the items from index `start' of the data in
+   `fp' with one read. Returns -1 on failure. */
+int
+lazy_read(struct feed *f, FILE *fp, struct lazyblock *b, size_t start)
+{
+	struct item *item;
+	struct stat st;
+	off_t base, end;
+	size_t i, n;
+	ssize_t r, len;
+	char *line, *nl, *lineend;
+
+	n = MIN(LAZY_BLOCKITEMS, curitems.len - start);
+	base = curitems.items[start].offset;
+	if (start + n < curitems.len) {
+		end = curitems.items[start + n].offset;
+	} else if (f->gz) {
+		end = gz_size(f->gz, fileno(fp));
+	} else {
+		if (fstat(fileno(fp), &st) == -1)
+			die("fstat: %s", f->name);
+		end = st.st_size;
+	}
+	if (end <= base)
+		return -1;
+
+	/* pread() does not change the file offset: it can be used by a forked
+	   process and the stream is unchanged */
+	len = end - base;
+	b->data = erealloc(NULL, len + 1);
+	for (i = 0; i < (size_t)len; i += r) {
+		r = f->gz ? gz_pread(f->gz, fileno(fp), b->data + i,
+		                     len - i, base + i) :
+		    pread(fileno(fp), b->data + i, len - i, base + i);
+		if (r == -1) {
+			if (errno != EINTR)
+				die("pread: %s", f->name);
+			r = 0;
+		} else if (!r) {
+			break; /* truncated */
+		}
+	}
+	len = i;
+	b->data[len] = '\0';
+
+	b->start = start;
+	b->n = MIN(LAZY_BLOCKITEMS, curitems.len - start);
+	b->used = ++lazyclock;
+	for (i = start; i < start + b->n; i++) {
+		item = &(curitems.items[i]);
+		if (item->offset - base >= len) {
+			/* data was changed: the lines are not available */
+			b->n = i - start;
+			break;
+		}
+		line = b->data + (item->offset - base);
+		lineend = i + 1 < start + b->n && curitems.items[i + 1].offset - base <= len ?
+		          b->data + (curitems.items[i + 1].offset - base) : b->data + len;
+		if ((nl = memchr(line, '\n', lineend - line))) {
+			*nl = '\0';
+		} else if (lineend < b->data + len) {
+			b->n = i - start; /* data was changed */
+			break;
+		}
+		linetoitem(line, item);
+	}
+	/* no lines are available: the slot is free */
+	if (!b->n) {
+		free(b->data);
+		b->data = NULL;
+	}
+
+	return 0;
+}
+
+/* Load the block of lines of the items from index `start' of the data in `fp',
+   the least recently used block is unloaded. Returns -1 on failure. */
+int
+lazy_load(struct feed *f, FILE *fp, size_t start)
+{
+	struct lazyblock *b, *lru = NULL;
+	size_t i;
+	int r;
+
+	for (i = 0; i < LEN(lazyblocks); i++) {
+		b = &lazyblocks[i];
+		if (b->n && b->start == start) {
+			/* items were appended to a partial block: reload it */
+			if (b->start + b->n < curitems.len && b->n < LAZY_BLOCKITEMS)
+				lazy_evict(b);
+			else
+				return 0;
+		}
+		if (!lru || !b->n || (lru->n && b->used < lru->used))
+			lru = b;
+	}
+	if (lru->data)
+		lazy_evict(lru);
+	b = lru;
+	STATS_TIME(StatLazy, r = f == allfeed ? lazy_load_feeds(b, start) :
+	           lazy_read(f, fp, b, start));
+
+	return r;
+}
+
+/* Get the loaded item at index `pos'. The item is lazy-loaded if needed: the
+   block of the item and the next blocks in the scroll direction are read.
+   Returns NULL if the line could not be read. */
+struct item *
+item_load(size_t pos)
+{
+	struct item *item;
+	struct feed *f;
+	FILE *fp;
+	size_t block, i;
+	int dir;
+
+	item = &(curitems.items[pos]);
+
+	f = curfeed;
+	/* the stdin stream is lazy-loaded from its temporary file */
+	fp = f && f->path ? f->fp : streamspill;
+	if (f && (fp || f == allfeed) && !item->line) {
+		block = pos - (pos % LAZY_BLOCKITEMS);
+		if (lazy_load(f, fp, block) == -1 || !item->line)
+			return NULL;
+
+		/* read-ahead, keep the current block loaded */
+		dir = pos < lazyprevpos ? -1 : 1;
+		for (i = 1; i <= (size_t)lazyreadahead && i < LEN(lazyblocks); i++) {
+			if (dir < 0 && block < i * LAZY_BLOCKITEMS)
+				break;
+			if (dir > 0 && block + i * LAZY_BLOCKITEMS >= curitems.len)
+				break;
+			lazy_load(f, fp, block + dir * (off_t)(i * LAZY_BLOCKITEMS));
+		}
+	}
+	if (lazyload || f == allfeed || curitems.mapped) {
+		lazyprevpos = pos;
+		for (i = 0; i < LEN(lazyblocks); i++) {
+			if (lazyblocks[i].n && pos >= lazyblocks[i].start &&
+			    pos < lazyblocks[i].start + lazyblocks[i].n)
+				lazyblocks[i].used = ++lazyclock;
+		}
+	}
+	return item;
+}
+
+/* Index of the item at row `pos' of the items pane. */
+size_t
+item_index(off_t pos)
+{
+	return curview ? curview->idx[pos] : (size_t)pos;
+}
+
+static int cursort; /* sort order for sort_cmp() */
+
+int
+sort_cmpidx(size_t i1, size_t i2)
+{
+	struct sortcache *c = &sortcaches[cursort];
+	struct item *a = &(curitems.items[i1]), *b = &(curitems.items[i2]);
+	int r = 0;
+
+	switch (cursort) {
+	case SortTime: /* newest first */
+		if (a->timestamp != b->timestamp)
+			return a->timestamp < b->timestamp ? 1 : -1;
+		break;
+	case SortTitle:
+	case SortAuthor:
+		r = strcasecmp(c->keys + c->keyoff[i1], c->keys + c->keyoff[i2]);
+		break;
+	}
+	if (r)
+		return r;
+	return i1 < i2 ? -1 : (i1 > i2); /* stable: by position */
+}
+
+int
+sort_cmp(const void *v1, const void *v2)
+{
+	return sort_cmpidx(*(const size_t *)v1, *(const size_t *)v2);
+}
+
+/* Sort the loaded items in the order `sort', only the items which were
+   appended since the last sort are sorted and merged. */
+void
+sort_items(int sort)
+{
+	struct sortcache *c = &sortcaches[sort];
+	struct item *item;
+	const char *key;
+	size_t *perm, i, j, k, len, n0, n;
+
+	n0 = c->n;
+	n = curitems.len;
+	if (n0 == n)
+		return;
+
+	/* copy the keys, the lines could be lazy-loaded */
+	if (sort == SortTitle || sort == SortAuthor) {
+		c->keyoff = erealloc(c->keyoff, n * sizeof(c->keyoff[0]));
+		for (i = n0; i < n; i++) {
+			if ((item = item_load(i)))
+				key = itemfield(item, sort == SortTitle ? FieldTitle : FieldAuthor);
+			else
+				key = "";
+			len = strlen(key) + 1;
+			if (c->keyslen + len > c->keyscap) {
+				c->keyscap = MAX(c->keyscap * 2, c->keyslen + len + 4096);
+				c->keys = erealloc(c->keys, c->keyscap);
+			}
+			memcpy(c->keys + c->keyslen, key, len);
+			c->keyoff[i] = c->keyslen;
+			c->keyslen += len;
+		}
+	}
+
+	cursort = sort;
+	perm = erealloc(NULL, n * sizeof(perm[0]));
+	for (i = n0; i < n; i++)
+		perm[i] = i;
+	qsort(perm + n0, n - n0, sizeof(perm[0]), sort_cmp);
+
+	/* merge the sorted items with the new sorted items */
+	if (n0) {
+		memcpy(perm, c->perm, n0 * sizeof(perm[0]));
+		free(c->perm);
+		c->perm = erealloc(NULL, n * sizeof(perm[0]));
+		for (i = 0, j = n0, k = 0; k < n; k++) {
+			if (j == n || (i < n0 && sort_cmpidx(perm[i], perm[j]) < 0))
+				c->perm[k] = perm[i++];
+			else
+				c->perm[k] = perm[j++];
+		}
+		free(perm);
+	} else {
+		free(c->perm);
+		c->perm = perm;
+	}
+	c->n = n;
+}
+
+/* Does the item have the category `s', the categories are separated by '|'.
+   The comparison is case-insensitive. */
+int
+item_hascategory(struct item *item, const char *s)
+{
+	const char *p, *e;
+	size_t len = strlen(s);
+
+	for (p = itemfield(item, FieldCategory); *p; p = *e ? e + 1 : e) {
+		if (!(e = strchr(p, '|')))
+			e = p + strlen(p);
+		if ((size_t)(e - p) == len && !strncasecmp(p, s, len))
+			return 1;
+	}
+	return 0;
+}
+
+/* Build the rows of view `v' with the items in the order `sort' and the
+   filters `filter'. */
+void
+view_build(struct itemview *v, int sort, int filter)
+{
+	struct item *item;
+	size_t i, j;
+
+	if (sort != SortFile)
+		sort_items(sort);
+
+	free(v->idx);
+	v->idx = erealloc(NULL, (curitems.len + 1) * sizeof(v->idx[0]));
+	v->n = 0;
+	for (j = 0; j < curitems.len; j++) {
+		i = sort != SortFile ? sortcaches[sort].perm[j] : j;
+		item = &(curitems.items[i]);
+		if ((filter & FilterNew) && !item->isnew)
+			continue;
+		/* the lines are needed for the other filters */
+		if ((filter & (FilterEnclosure | FilterCategory)) &&
+		    !(item = item_load(i)))
+			continue;
+		if ((filter & FilterEnclosure) && !itemfield(item, FieldEnclosure)[0])
+			continue;
+		if ((filter & FilterCategory) &&
+		    !item_hascategory(item, itemcategory ? itemcategory : ""))
+			continue;
+		v->idx[v->n++] = i;
+	}
+	v->ok = 1;
+}
+
+/* Free the views of the items, if `keepsorted' is set then the sorted items
+   are kept: for merging appended items. */
+void
+views_free(int keepsorted)
+{
+	size_t i, j;
+
+	for (i = 0; i < SortLast; i++) {
+		for (j = 0; j < FilterLast; j++) {
+			free(views[i][j].idx);
+			views[i][j].idx = NULL;
+			views[i][j].n = 0;
+			views[i][j].ok = 0;
+		}
+		if (keepsorted)
+			continue;
+		free(sortcaches[i].perm);
+		free(sortcaches[i].keys);
+		free(sortcaches[i].keyoff);
+		memset(&sortcaches[i], 0, sizeof(sortcaches[i]));
+	}
+	curview = NULL;
+}
+
+/* The items which match `filter' were changed: the views which use it are
+   built again when used. The current view is kept until it is set again. */
+void
+views_stale(int filter)
+{
+	size_t i, j;
+
+	for (i = 0; i < SortLast; i++) {
+		for (j = 0; j < FilterLast; j++) {
+			if (j & filter)
+				views[i][j].ok = 0;
+		}
+	}
+}
+
+/* Set the rows of the items pane to view of the current sort order and
+   filters. */
+void
+items_setview(void)
+{
+	struct pane *p = &panes[PaneItems];
+	struct itemview *v;
+
+	if (itemsort == SortFile && !itemfilter) {
+		curview = NULL;
+		p->nrows = curitems.len;
+	} else {
+		v = &views[itemsort][itemfilter];
+		if (!v->ok)
+			view_build(v, itemsort, itemfilter);
+		curview = v;
+		p->nrows = v->n;
+	}
+	if (p->pos >= p->nrows)
+		p->pos = p->nrows ? p->nrows - 1 : 0;
+	p->dirty = 1;
+	searchpane = NULL; /* the rows changed */
+}
+
+/* Change the sort order and filters of the items pane, the selected item is
+   kept selected if it is visible. */
+void
+items_setorder(int sort, int filter)
+{
+	struct pane *p = &panes[PaneItems];
+	off_t pos;
+	size_t i = 0;
+	int sel = 0;
+
+	if (p->nrows) {
+		i = item_index(p->pos);
+		sel = 1;
+	}
+	itemsort = sort;
+	itemfilter = filter;
+	items_setview();
+
+	for (pos = 0; sel && pos < p->nrows; pos++) {
+		if (item_index(pos) == i)
+			break;
+	}
+	pane_setpos(p, sel && pos < p->nrows ? pos : 0);
+	statusbar.dirty = 1;
+}
+
+/* Format the local time `t' as "YYYY-MM-DD HH:MM" in `buf' (not
+   NUL-terminated). Many items are of the same day: the date of a day is
+   memoized, if the day has no change of the UTC offset (86400 seconds). */
+int
+timeformat(time_t t, char *buf)
+{
+	struct datememo *m;
+	struct tm tm, tm2;
+	time_t start, secs;
+	char tmp[64];
+
+	/* the local day starts in the UTC day of `t' or the day before */
+	m = &datememo[(uintmax_t)(t / 86400) % LEN(datememo)];
+	if (!m->ok || t < m->start || t - m->start >= 86400)
+		m = &datememo[(uintmax_t)(t / 86400 - 1) % LEN(datememo)];
+	if (!m->ok || t < m->start || t - m->start >= 86400) {
+		if (!localtime_r(&t, &tm))
+			return -1;
+		snprintf(tmp, sizeof(tmp), "%04d-%02d-%02d %02d:%02d",
+		         tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday,
+		         tm.tm_hour, tm.tm_min);
+		memcpy(buf, tmp, 16);
+
+		/* the day is exactly 24 hours: cache it */
+		start = t - (tm.tm_hour * 3600 + tm.tm_min * 60 + tm.tm_sec);
+		secs = start + 86399;
+		if (localtime_r(&start, &tm2) && !tm2.tm_hour && !tm2.tm_min &&
+		    !tm2.tm_sec && localtime_r(&secs, &tm2) &&
+		    tm2.tm_mday == tm.tm_mday && tm2.tm_hour == 23 &&
+		    tm2.tm_min == 59 && tm2.tm_sec == 59) {
+			m = &datememo[(uintmax_t)(start / 86400) % LEN(datememo)];
+			m->start = start;
+			m->ok = 1;
+			memcpy(m->date, tmp, 10);
+		}
+		return 0;
+	}
+	secs = t - m->start;
+	memcpy(buf, m->date, 10);
+	buf[10] = ' ';
+	buf[11] = '0' + secs / 36000;
+	buf[12] = '0' + secs / 3600 % 10;
+	buf[13] = ':';
+	buf[14] = '0' + secs % 3600 / 600;
+	buf[15] = '0' + secs % 600 / 60;
+
+	return 0;
+}
+
+/* Get the row of the item at `pos' of the items pane, the row is valid until
+   the next call. */
+struct row *
+item_row_get(struct pane *p, off_t pos)
+{
+	static struct row itemrow;
+	struct item *item;
+
+	if (!(item = item_load(item_index(pos))))
+		return NULL;
+	itemrow.text = NULL;
+	itemrow.bold = item->isnew;
+	itemrow.data = item;
+
+	return &itemrow;
+}
+
+/* Custom formatter for item row. */
+char *
+item_row_format(struct pane *p, struct row *row)
+{
+	/* static, reuse local buffers */
+	static char *text;
+	static size_t textsize;
+	struct item *item;
+	struct feed *f = NULL;
+	size_t len, needsize, prefixlen, seplen, titlelen;
+	char *title, *prefix = "", *sep = "";
+	int w, prefixw = 0, prefixplain = 1;
+
+	item = row->data;
+	title = itemfield(item, FieldTitle);
+	/* aggregate feed: show the name of the feed of the item */
+	if (curfeed == allfeed) {
+		f = &feeds[item->feed];
+		prefix = f->name;
+		prefixw = f->namew + 2;
+		prefixplain = f->nameplain;
+		sep = ": ";
+	}
+	if (!item->titleset) {
+		/* cache the width of the title */
+		w = utf8width(title);
+		item->titleplain = w != -1;
+		item->titlew = w != -1 ? w : 0;
+		item->titleset = 1;
 	}
 
-	needsize = bufwsize + sizeof(counts) + 1;
+	prefixlen = strlen(prefix);
+	seplen = strlen(sep);
+	titlelen = strlen(title);
+	needsize = prefixlen + seplen + titlelen + 20;
 	if (needsize > textsize) {
 		text = erealloc(text, needsize);
 		textsize = needsize;
 	}
 
-	if (utf8pad(bufw, bufwsize, feed->name, w, ' ') != -1)
-		snprintf(text, textsize, "%s%s", bufw, counts);
-	else
-		text[0] = '\0';
+	/* "@ YYYY-MM-DD HH:MM " */
+	text[0] = itemfield(item, FieldEnclosure)[0] ? '@' : ' ';
+	text[1] = ' ';
+	if (!item->timeok || timeformat(item->timestamp, text + 2) == -1)
+		memset(text + 2, ' ', 16);
+	text[18] = ' ';
+	len = 19;
+	memcpy(text + len, prefix, prefixlen);
+	len += prefixlen;
+	memcpy(text + len, sep, seplen);
+	len += seplen;
+	memcpy(text + len, title, titlelen + 1);
+
+	/* the prefix is ASCII */
+	if (item->titleplain && prefixplain)
+		row->textw = 19 + item->titlew + prefixw;
 
 	return text;
 }
 
+/* Custom matcher for item row. */
 int
-feed_row_match(struct pane *p, struct row *row, const char *s)
+item_row_match(struct pane *p, struct row *row, const char *s)
 {
-	struct feed *feed;
+	struct item *item;
 
-	feed = row->data;
+	item = row->data;
 
-	return (strcasestr(feed->name, s) != NULL);
+	/* optimization: match the title without formatting the row, a match
+	   which starts in the prefix of the row starts with one of its
+	   characters */
+	if (strcasestr(itemfield(item, FieldTitle), s))
+		return 1;
+	if (!strchr(" @-:0123456789", s[0]) && curfeed != allfeed)
+		return 0;
+
+	return (strcasestr(item_row_format(p, row), s) != NULL);
 }
 
-struct row *
-item_row_get(struct pane *p, off_t pos)
+/* Mark the items as read or unread by the builtin writer: read URLs are
+   appended to the urlfile, for unread URLs the file is rewritten from the read
+   URLs in memory. Returns 0 on success. */
+int
+markread_builtin(struct pane *p, off_t from, off_t to, int isread)
 {
-	struct row *itemrow;
 	struct item *item;
-	struct feed *f;
-	char *line = NULL;
-	size_t linesize = 0;
-	ssize_t linelen;
+	char *buf = NULL, *match;
+	size_t cap = 0, len = 0, n;
+	off_t i;
+	int isnew = !isread, r;
 
-	itemrow = p->rows + pos;
-	item = itemrow->data;
+	urls_read(); /* do not lose URLs which were added by others */
 
-	f = curfeed;
-	if (f && f->path && f->fp && !item->line) {
-		if (fseek(f->fp, item->offset, SEEK_SET))
-			die("fseek: %s", f->path);
+	for (i = from; i <= to && i < p->nrows; i++) {
+		item = &(curitems.items[item_index(i)]);
+		if (item->isnew == isnew)
+			continue;
+		if (!item->line)
+			pane_row_get(p, i);
+		if (!(match = itemmatchnew(item)))
+			continue;
+		if (!isread) {
+			urls_remove(match);
+			continue;
+		}
+		n = strlen(match);
+		if (len + n + 1 > cap) {
+			cap = MAX(cap * 2, len + n + 1);
+			buf = erealloc(buf, cap);
+		}
+		memcpy(buf + len, match, n);
+		buf[len + n] = '\n';
+		len += n + 1;
+	}
+	r = isread ? urls_append(buf, len) : urls_write();
+	free(buf);
 
-		if ((linelen = getline(&line, &linesize, f->fp)) <= 0) {
-			if (ferror(f->fp))
-				die("getline: %s", f->path);
-			return NULL;
+	/* failed: restore the removed URLs */
+	if (r == -1 && !isread) {
+		for (i = from; i <= to && i < p->nrows; i++) {
+			item = &(curitems.items[item_index(i)]);
+			if (item->isnew == isnew)
+				continue;
+			if (!item->line)
+				pane_row_get(p, i);
+			if ((match = itemmatchnew(item)))
+				urls_addurl(match);
 		}
+	}
+	return r == -1;
+}
 
-		if (line[linelen - 1] == '\n')
-			line[--linelen] = '\0';
+/* Queue the mark of the URL, it is written later by marks_flush(). */
+void
+marks_add(const char *url, int isread)
+{
+	size_t n;
+
+	n = strlen(url) + 1;
+	if (marklen + n + 1 > markcap) {
+		markcap = MAX(markcap * 2, marklen + n + 1);
+		markbuf = erealloc(markbuf, markcap);
+	}
+	markbuf[marklen] = isread ? 'r' : 'u';
+	memcpy(markbuf + marklen + 1, url, n);
+	marklen += n + 1;
+	nmarks++;
+	marktime = time(NULL);
+}
 
-		linetoitem(estrdup(line), item);
-		free(line);
+/* Apply the unflushed marks in their order to the read URLs in memory, used
+   when the urlfile was read again. */
+void
+marks_apply(void)
+{
+	size_t off;
+	char *url;
 
-		itemrow->data = item;
+	for (off = 0; off < marklen; off += strlen(url) + 2) {
+		url = markbuf + off + 1;
+		if (markbuf[off] == 'r')
+			urls_addurl(url);
+		else
+			urls_remove(url);
 	}
-	return itemrow;
 }
 
-/* Custom formatter for item row. */
-char *
-item_row_format(struct pane *p, struct row *row)
+/* Write the URLs with the mark command `cmd', returns its exit status. */
+int
+marks_write(const char *cmd, const char *buf, size_t len)
 {
-	/* static, reuse local buffers */
-	static char *text;
-	static size_t textsize;
-	struct item *item;
-	struct tm tm;
-	size_t needsize;
+	FILE *fp;
+	pid_t pid, wpid;
+	int status;
 
-	item = row->data;
+	if (!(fp = spawnpipe(cmd, -1, 0, &pid)))
+		return -1;
+	fwrite(buf, 1, len, fp);
+	fclose(fp);
+	while ((wpid = waitpid(pid, &status, 0)) == -1 && errno == EINTR)
+		;
 
-	needsize = strlen(item->fields[FieldTitle]) + 21;
-	if (needsize > textsize) {
-		text = erealloc(text, needsize);
-		textsize = needsize;
+	return wpid == -1 ? -1 : status;
+}
+
+/* Keep only the last mark of each URL, in the order of the marks. */
+void
+marks_dedupe(void)
+{
+	size_t *last, i, mask, n, off, size, w;
+	char *url;
+
+	for (size = 16; size < nmarks * 2; size *= 2)
+		;
+	mask = size - 1;
+	/* offset of the URL of the last mark of each URL */
+	last = ecalloc(size, sizeof(last[0]));
+	for (off = 0; off < marklen; off += strlen(url) + 2) {
+		url = markbuf + off + 1;
+		i = strhash(url) & mask;
+		while (last[i] && strcmp(markbuf + last[i], url))
+			i = (i + 1) & mask;
+		last[i] = off + 1;
 	}
+	for (off = w = 0, nmarks = 0; off < marklen; off += n + 2) {
+		url = markbuf + off + 1;
+		n = strlen(url);
+		i = strhash(url) & mask;
+		while (strcmp(markbuf + last[i], url))
+			i = (i + 1) & mask;
+		if (last[i] != off + 1)
+			continue; /* marked again later */
+		memmove(markbuf + w, markbuf + off, n + 2);
+		w += n + 2;
+		nmarks++;
+	}
+	marklen = w;
+	free(last);
+}
 
-	if (item->timeok && localtime_r(&(item->timestamp), &tm)) {
-		snprintf(text, textsize, "%c %04d-%02d-%02d %02d:%02d %s",
-		         item->fields[FieldEnclosure][0] ? '@' : ' ',
-		         tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday,
-		         tm.tm_hour, tm.tm_min, item->fields[FieldTitle]);
-	} else {
-		snprintf(text, textsize, "%c                  %s",
-		         item->fields[FieldEnclosure][0] ? '@' : ' ',
-		         item->fields[FieldTitle]);
+/* Write the unflushed marks in one batch: the read and the unread URLs each
+   by one append or rewrite of the urlfile or by one run of the mark command.
+   A URL which was marked multiple times is written once with its last mark.
+   The marks of a batch which failed are kept and written again later.
+   Returns -1 on failure. */
+int
+marks_flush(void)
+{
+	char *buf = NULL, *url;
+	const char *cmd;
+	size_t cap = 0, len, n, off, w;
+	int failed[2] = { 0, 0 }, isread;
+
+	if (!nmarks)
+		return 0;
+	urls_read(); /* do not lose URLs which were added by others */
+	marks_dedupe();
+
+	for (isread = 1; isread >= 0; isread--) {
+		len = 0;
+		for (off = 0; off < marklen; off += n + 2) {
+			url = markbuf + off + 1;
+			n = strlen(url);
+			if ((markbuf[off] == 'r') != isread)
+				continue;
+			if (len + n + 1 > cap) {
+				cap = MAX(cap * 2, len + n + 1);
+				buf = erealloc(buf, cap);
+			}
+			memcpy(buf + len, url, n);
+			buf[len + n] = '\n';
+			len += n + 1;
+		}
+		if (!len)
+			continue;
+		/* builtin: the unread URLs are removed in memory already */
+		if ((cmd = isread ? markreadcmd : markunreadcmd))
+			failed[isread] = marks_write(cmd, buf, len) != 0;
+		else if (isread)
+			failed[1] = urls_append(buf, len) == -1;
+		else
+			failed[0] = urls_write() == -1;
+		/* builtin: the rewritten file also has the read URLs */
+		if (!isread && !cmd && !failed[0] && !markreadcmd)
+			failed[1] = 0;
 	}
+	free(buf);
 
-	return text;
+	/* keep the marks of the batches which failed */
+	for (off = w = 0, nmarks = 0; off < marklen; off += n + 2) {
+		n = strlen(markbuf + off + 1);
+		if (!failed[markbuf[off] == 'r'])
+			continue;
+		memmove(markbuf + w, markbuf + off, n + 2);
+		w += n + 2;
+		nmarks++;
+	}
+	marklen = w;
+	if (!nmarks)
+		return 0;
+	marktime = time(NULL); /* try again later */
+	return -1;
+}
+
+/* Marks are unflushed and no marks happened for a while, they are written
+   when the feeds are not counted in the background. */
+int
+marks_ready(void)
+{
+	return nmarks && time(NULL) - marktime >= markdefer;
 }
 
 void
 markread(struct pane *p, off_t from, off_t to, int isread)
 {
-	struct row *row;
 	struct item *item;
+	char *match;
 	FILE *fp;
 	off_t i;
 	const char *cmd;
-	int isnew = !isread, pid, wpid, status, visstart;
+	pid_t pid, wpid;
+	int isnew = !isread, status, visstart;
 
 	if (!urlfile || !p->nrows)
 		return;
 
 	cmd = isread ? markreadcmd : markunreadcmd;
 
-	switch ((pid = fork())) {
-	case -1:
-		die("fork");
-	case 0:
-		dup2(devnullfd, 1);
-		dup2(devnullfd, 2);
-
-		errno = 0;
-		if (!(fp = popen(cmd, "w")))
-			die("popen: %s", cmd);
-
+	if (markdefer) {
+		status = 0; /* written later in one batch by marks_flush() */
+	} else if (!cmd) {
+		status = markread_builtin(p, from, to, isread);
+	} else if (!(fp = spawnpipe(cmd, -1, 0, &pid))) {
+		status = -1;
+	} else {
 		for (i = from; i <= to && i < p->nrows; i++) {
-			/* do not use pane_row_get: no need for lazyload */
-			row = &(p->rows[i]);
-			item = row->data;
-			if (item->isnew != isnew) {
-				fputs(item->matchnew, fp);
+			item = &(curitems.items[item_index(i)]);
+			if (item->isnew == isnew)
+				continue;
+			/* lazyload: read the line for the match field */
+			if (!item->line)
+				pane_row_get(p, i);
+			if ((match = itemmatchnew(item))) {
+				fputs(match, fp);
 				putc('\n', fp);
 			}
 		}
-		status = pclose(fp);
-		status = WIFEXITED(status) ? WEXITSTATUS(status) : 127;
-		_exit(status);
-	default:
-		while ((wpid = wait(&status)) >= 0 && wpid != pid)
+		fclose(fp);
+		while ((wpid = waitpid(pid, &status, 0)) == -1 && errno == EINTR)
 			;
+		if (wpid == -1)
+			status = -1;
+	}
+	/* fail: exit statuscode was non-zero */
+	if (status)
+		return;
 
-		/* fail: exit statuscode was non-zero */
-		if (status)
-			break;
+	visstart = pane_top(p); /* visible start */
+	for (i = from; i <= to && i < p->nrows; i++) {
+		item = &(curitems.items[item_index(i)]);
+		if (item->isnew == isnew)
+			continue;
 
-		visstart = p->pos - (p->pos % p->height); /* visible start */
-		for (i = from; i <= to && i < p->nrows; i++) {
-			row = &(p->rows[i]);
-			item = row->data;
-			if (item->isnew == isnew)
-				continue;
+		item->isnew = isnew;
+		curfeed->totalnew += isnew ? 1 : -1;
+		if (curfeed == allfeed)
+			feeds[item->feed].totalnew += isnew ? 1 : -1;
+
+		/* update the read URLs directly */
+		if (!item->line)
+			pane_row_get(p, i);
+		if ((match = itemmatchnew(item))) {
+			if (isread)
+				urls_addurl(match);
+			else
+				urls_remove(match);
+			if (markdefer)
+				marks_add(match, isread);
+		}
+
+		/* draw if visible on screen */
+		if (i >= visstart && i < visstart + p->height)
+			pane_row_draw(p, i, i == p->pos);
+	}
+	/* the counts of the current feed are up-to-date, other feeds
+	   could have the same URLs */
+	urls_lock(1);
+	urlsgen++;
+	urls_unlock();
+	curfeed->urlsgen = urlsgen;
+	views_stale(FilterNew);
+	updatesidebar();
+	updatetitle();
+}
+
+/* Lock the read URLs while counting, for writing if `wr' is set. */
+void
+urls_lock(int wr)
+{
+	if (!countjob.running)
+		return;
+	if (wr)
+		pthread_rwlock_wrlock(&urlslock);
+	else
+		pthread_rwlock_rdlock(&urlslock);
+}
+
+void
+urls_unlock(void)
+{
+	if (countjob.running)
+		pthread_rwlock_unlock(&urlslock);
+}
+
+/* Generation of the read URLs, it is also read by the count workers. */
+unsigned long
+urls_gen(void)
+{
+	unsigned long gen;
+
+	urls_lock(0);
+	gen = urlsgen;
+	urls_unlock();
+
+	return gen;
+}
+
+/* Lookup the URL with hash `h', if `url' is NULL then only match the hash. */
+struct urlent *
+urls_lookup(uint64_t h, const char *url)
+{
+	size_t i, mask;
+
+	if (!urltabsize)
+		return NULL;
+	mask = urltabsize - 1;
+	for (i = h & mask; urltab[i].off; i = (i + 1) & mask) {
+		if (urltab[i].hash == h &&
+		    (!url || !strcmp(urlbuf + urltab[i].off - 1, url)))
+			return &urltab[i];
+	}
+	return NULL;
+}
+
+/* Resize the hash table to `size' entries, which must be a power of 2. */
+void
+urls_resize(size_t size)
+{
+	struct urlent *t;
+	size_t i, j, mask;
+
+	t = ecalloc(size, sizeof(t[0]));
+	mask = size - 1;
+	for (i = 0; i < urltabsize; i++) {
+		if (!urltab[i].off)
+			continue;
+		for (j = urltab[i].hash & mask; t[j].off; j = (j + 1) & mask)
+			;
+		t[j] = urltab[i];
+	}
+	free(urltab);
+	urltab = t;
+	urltabsize = size;
+}
+
+/* Insert the URL at offset `off' in the buffer with hash `h', it should not
+   be in the set already. */
+void
+urls_insert(size_t off, uint64_t h)
+{
+	size_t i, mask;
+
+	/* keep the load factor below 1/2 */
+	if ((nurls + 1) * 2 > urltabsize)
+		urls_resize(urltabsize ? urltabsize * 2 : 64);
+	mask = urltabsize - 1;
+	for (i = h & mask; urltab[i].off; i = (i + 1) & mask)
+		;
+	urltab[i].hash = h;
+	urltab[i].off = off + 1;
+	nurls++;
+}
+
+/* Add a copy of the URL, duplicates are ignored. */
+void
+urls_addurl(const char *url)
+{
+	uint64_t h;
+	size_t len;
+
+	h = strhash(url);
+	if (urls_lookup(h, url))
+		return;
+
+	len = strlen(url) + 1;
+	urls_lock(1);
+	if (urlbuflen + len + 1 >= urlbufsiz) {
+		urlbufsiz = MAX(urlbufsiz * 2, urlbuflen + len + 1);
+		urlbuf = erealloc(urlbuf, urlbufsiz);
+	}
+	memcpy(urlbuf + urlbuflen, url, len);
+	urls_insert(urlbuflen, h);
+	urlbuflen += len;
+	urls_unlock();
+}
+
+/* Remove the URL, entries after it in the probe sequence are moved back. */
+void
+urls_remove(const char *url)
+{
+	struct urlent *e;
+	size_t i, j, k, mask;
+
+	if (!(e = urls_lookup(strhash(url), url)))
+		return;
+	urls_lock(1);
+	mask = urltabsize - 1;
+	i = e - urltab;
+	for (j = (i + 1) & mask; urltab[j].off; j = (j + 1) & mask) {
+		k = urltab[j].hash & mask; /* position it hashes to */
+		/* the entry can stay if `k' is cyclically in (i, j] */
+		if (i <= j ? (i < k && k <= j) : (i < k || k <= j))
+			continue;
+		urltab[i] = urltab[j];
+		i = j;
+	}
+	urltab[i].off = 0;
+	urltab[i].hash = 0;
+	nurls--;
+	urls_unlock();
+}
 
-			row->bold = item->isnew = isnew;
-			curfeed->totalnew += isnew ? 1 : -1;
+/* Append the lines `buf' of length `len' to the urlfile with one write and
+   sync it. Returns -1 on failure. */
+int
+urls_append(const char *buf, size_t len)
+{
+	size_t i;
+	ssize_t n;
+	int fd, r = 0;
 
-			/* draw if visible on screen */
-			if (i >= visstart && i < visstart + p->height)
-				pane_row_draw(p, i, i == p->pos);
+	if ((fd = open(urlfile, O_WRONLY | O_APPEND | O_CREAT, 0666)) == -1)
+		return -1;
+	for (i = 0; i < len; i += n) {
+		if ((n = write(fd, buf + i, len - i)) == -1) {
+			if (errno == EINTR) {
+				n = 0;
+				continue;
+			}
+			r = -1;
+			break;
 		}
-		updatesidebar();
-		updatetitle();
 	}
+	if (fsync(fd) == -1)
+		r = -1;
+	if (close(fd) == -1)
+		r = -1;
+	return r;
 }
 
+/* Write the read URLs in memory to a new file which atomically replaces the
+   urlfile, duplicates and removed URLs are compacted away. Returns -1 on
+   failure. */
 int
-urls_cmp(const void *v1, const void *v2)
+urls_write(void)
 {
-	return strcmp(*((char **)v1), *((char **)v2));
+	struct urlent *e;
+	struct stat st;
+	FILE *fp;
+	char *tmp, *url;
+	size_t len, off;
+	int fd, r = -1;
+
+	len = strlen(urlfile) + sizeof(".XXXXXX");
+	tmp = ecalloc(1, len);
+	snprintf(tmp, len, "%s.XXXXXX", urlfile);
+
+	if ((fd = mkstemp(tmp)) == -1)
+		goto end;
+	if (!(fp = fdopen(fd, "wb"))) {
+		close(fd);
+		unlink(tmp);
+		goto end;
+	}
+	/* keep the permissions of the file */
+	if (stat(urlfile, &st) != -1)
+		fchmod(fd, st.st_mode & 07777);
+
+	/* write the URLs in the order they were read or added */
+	for (off = 0; off < urlbuflen; off += strlen(url) + 1) {
+		url = urlbuf + off;
+		if ((e = urls_lookup(strhash(url), url)) && e->off == off + 1) {
+			fputs(url, fp);
+			putc('\n', fp);
+		}
+	}
+	r = fflush(fp) || fsync(fd) == -1 || ferror(fp) ? -1 : 0;
+	if (fclose(fp))
+		r = -1;
+	if (r == -1 || rename(tmp, urlfile) == -1) {
+		unlink(tmp);
+		r = -1;
+	}
+end:
+	free(tmp);
+	return r;
 }
 
 int
 urls_isnew(const char *url)
 {
-	return bsearch(&url, urls, nurls, sizeof(char *), urls_cmp) == NULL;
+	int r;
+
+	urls_lock(0);
+	r = urls_lookup(strhash(url), url) == NULL;
+	urls_unlock();
+
+	return r;
+}
+
+/* lookup by the hash of the URL, used for the items from an index */
+int
+urls_isnewhash(uint64_t h)
+{
+	int r;
+
+	urls_lock(0);
+	r = urls_lookup(h, NULL) == NULL;
+	urls_unlock();
+
+	return r;
 }
 
 void
 urls_free(void)
 {
-	while (nurls > 0)
-		free(urls[--nurls]);
-	free(urls);
-	urls = NULL;
-	nurls = 0;
+	free(urlbuf);
+	urlbuf = NULL;
+	urlbuflen = urlbufsiz = 0;
+	free(urltab);
+	urltab = NULL;
+	urltabsize = nurls = 0;
 }
 
-void
-urls_read(void)
+/* Read the URLs from the file at `offset' until the end and add them, the
+   duplicates are not stored. Returns the amount of added URLs. */
+size_t
+urls_readfrom(int fd, off_t offset)
 {
-	FILE *fp;
-	char *line = NULL;
-	size_t linesiz = 0, cap = 0;
+	char *end, *line, *nl;
+	size_t len, nadded = 0, nlines, size, start, w;
 	ssize_t n;
 
-	urls_free();
-
-	if (!urlfile)
-		return;
-	if (!(fp = fopen(urlfile, "rb")))
-		die("fopen: %s", urlfile);
+	if (lseek(fd, offset, SEEK_SET) == -1)
+		die("lseek: %s", urlfile);
 
-	while ((n = getline(&line, &linesiz, fp)) > 0) {
-		if (line[n - 1] == '\n')
-			line[--n] = '\0';
-		if (nurls + 1 >= cap) {
-			cap = cap ? cap * 2 : 16;
-			urls = erealloc(urls, cap * sizeof(char *));
+	start = urlbuflen;
+	for (;;) {
+		if (urlbuflen + 1 >= urlbufsiz) {
+			urlbufsiz = urlbufsiz ? urlbufsiz * 2 : 4096;
+			urlbuf = erealloc(urlbuf, urlbufsiz);
+		}
+		if ((n = read(fd, urlbuf + urlbuflen, urlbufsiz - urlbuflen - 1)) == -1) {
+			if (errno == EINTR)
+				continue;
+			die("read: %s", urlfile);
+		} else if (n == 0) {
+			break;
 		}
-		urls[nurls++] = estrdup(line);
+		urlbuflen += n;
 	}
-	if (ferror(fp))
-		die("getline: %s", urlfile);
-	fclose(fp);
-	free(line);
+	urlbuf[urlbuflen] = '\0';
+
+	/* size the table for the amount of lines */
+	end = urlbuf + urlbuflen;
+	for (nlines = 1, line = urlbuf + start;
+	     (nl = memchr(line, '\n', end - line)); line = nl + 1)
+		nlines++;
+	for (size = MAX(urltabsize, 64); size < (nurls + nlines) * 2; size *= 2)
+		;
+	if (size != urltabsize)
+		urls_resize(size);
+
+	/* split the lines and compact the duplicates away */
+	for (w = start, line = urlbuf + start; line < end; line = nl + 1) {
+		if (!(nl = memchr(line, '\n', end - line)))
+			nl = end;
+		*nl = '\0';
+		len = nl - line;
+		if (urls_lookup(strhash(line), line))
+			continue;
+		memmove(urlbuf + w, line, len + 1);
+		urls_insert(w, strhash(urlbuf + w));
+		w += len + 1;
+		nadded++;
+	}
+	urlbuflen = w;
+
+	return nadded;
+}
+
+/* Read the URLs, they are kept loaded and only read again if the file was
+   changed since the last read. If data was only appended to the file then
+   only the new lines are read. */
+void
+urls_read(void)
+{
+	struct stat st;
+	size_t n;
+	int fd, state = FeedChanged;
 
-	qsort(urls, nurls, sizeof(char *), urls_cmp);
+	if (!urlfile)
+		return;
+	if ((fd = open(urlfile, O_RDONLY)) == -1)
+		die("open: %s", urlfile);
+	if (urlbuf)
+		state = file_state(fd, &urlst, urldatahash, &st);
+	else if (fstat(fd, &st) == -1)
+		die("fstat: %s", urlfile);
+
+	urls_lock(1);
+	switch (state) {
+	case FeedUnchanged:
+		break;
+	case FeedAppended:
+		STATS_TIME(StatUrls, n = urls_readfrom(fd, urlst.st_size));
+		if (n)
+			urlsgen++;
+		break;
+	default:
+		urls_free();
+		STATS_TIME(StatUrls, urls_readfrom(fd, 0));
+		urlsgen++;
+		break;
+	}
+	urls_unlock();
+	if (state != FeedUnchanged) {
+		urlst = st;
+		urldatahash = feed_datahash(fd, st.st_size);
+		marks_apply(); /* the unflushed marks are not in the file */
+	}
+	close(fd);
 }
 
 int
 main(int argc, char *argv[])
 {
+	struct sigaction sa;
 	struct pane *p;
 	struct feed *f;
 	struct row *row;
 	size_t i;
 	char *name, *tmp;
 	char *search = NULL; /* search text */
-	int button, ch, fd, keymask, release, x, y;
+	int button, ch, dir, fd, keymask, release, x, y;
 	off_t pos;
 
 #ifdef __OpenBSD__
-	if (pledge("stdio rpath tty proc exec", NULL) == -1)
+	if (pledge("stdio rpath wpath cpath fattr tmppath tty proc exec", NULL) == -1)
 		die("pledge");
 #endif
 
 	setlocale(LC_CTYPE, "");
 
+	/* buffer the output, so a frame is written at once */
+	setvbuf(stdout, NULL, _IOFBF, 65536);
+
 	if ((tmp = getenv("SFEED_PLUMBER")))
 		plumbercmd = tmp;
 	if ((tmp = getenv("SFEED_PIPER")))
 		pipercmd = tmp;
 	if ((tmp = getenv("SFEED_YANKER")))
 		yankercmd = tmp;
+	if ((tmp = getenv("SFEED_HTMLCONV")))
+		htmlconvcmd = tmp;
 	if ((tmp = getenv("SFEED_PLUMBER_INTERACTIVE")))
 		plumberia = !strcmp(tmp, "1");
 	if ((tmp = getenv("SFEED_PIPER_INTERACTIVE")))
@@ -2095,8 +6086,28 @@ main(int argc, char *argv[])
 		markreadcmd = tmp;
 	if ((tmp = getenv("SFEED_MARK_UNREAD")))
 		markunreadcmd = tmp;
+	if ((tmp = getenv("SFEED_MARK_DEFER")))
+		markdefer = MAX(atoi(tmp), 0);
 	if ((tmp = getenv("SFEED_LAZYLOAD")))
 		lazyload = !strcmp(tmp, "1");
+	if ((tmp = getenv("SFEED_LAZYLOAD_READAHEAD")))
+		lazyreadahead = MAX(atoi(tmp), 0);
+	if ((tmp = getenv("SFEED_MMAP")))
+		usemmap = !strcmp(tmp, "1");
+	if ((tmp = getenv("SFEED_FEED_CACHE")))
+		feedcachemax = (size_t)MAX(atoi(tmp), 0) * 1024 * 1024;
+	if ((tmp = getenv("SFEED_INDEX_DIR")) && *tmp)
+		indexdir = tmp;
+	if ((tmp = getenv("SFEED_THREADS")))
+		countthreads = MAX(atoi(tmp), 1);
+	if ((tmp = getenv("SFEED_BACKGROUND_COUNT")))
+		bgcount = !strcmp(tmp, "1");
+	if ((tmp = getenv("SFEED_SCROLL_LINES")))
+		scrolllines = !strcmp(tmp, "1");
+	if ((tmp = getenv("SFEED_AUTORELOAD")))
+		autoreload = !strcmp(tmp, "1");
+	if ((tmp = getenv("SFEED_STREAM")))
+		streaming = !strcmp(tmp, "1");
 	urlfile = getenv("SFEED_URL_FILE"); /* can be NULL */
 	cmdenv = getenv("SFEED_AUTOCMD"); /* can be NULL */
 
@@ -2105,17 +6116,26 @@ main(int argc, char *argv[])
 
 	panes[PaneFeeds].row_format = feed_row_format;
 	panes[PaneFeeds].row_match = feed_row_match;
+	panes[PaneItems].row_get = item_row_get;
 	panes[PaneItems].row_format = item_row_format;
-	if (lazyload)
-		panes[PaneItems].row_get = item_row_get;
+	panes[PaneItems].row_match = item_row_match;
 
 	feeds = ecalloc(argc, sizeof(struct feed));
 	if (argc == 1) {
 		nfeeds = 1;
 		f = &feeds[0];
 		f->name = "stdin";
-		if (!(f->fp = fdopen(0, "rb")))
+		if (streaming && !isatty(0)) {
+			/* the items are read while the UI is shown */
+			if ((streamfd = dup(0)) == -1)
+				die("dup");
+			fcntl(streamfd, F_SETFL, O_NONBLOCK);
+			fcntl(streamfd, F_SETFD, FD_CLOEXEC);
+			if (lazyload && !(streamspill = tmpfile()))
+				die("tmpfile");
+		} else if (!(f->fp = fdopen(0, "rb"))) {
 			die("fdopen");
+		}
 	} else {
 		for (i = 1; i < argc; i++) {
 			f = &feeds[i - 1];
@@ -2125,10 +6145,42 @@ main(int argc, char *argv[])
 		}
 		nfeeds = argc - 1;
 	}
+	if ((tmp = getenv("SFEED_ALL_FEEDS")) && !strcmp(tmp, "1") && argc > 1) {
+		/* the feeds array has room for one more feed */
+		allfeed = &feeds[nfeeds++];
+		allfeed->name = "(all)";
+	}
+	for (i = 0; i < nfeeds; i++) {
+		/* cache the display width of the names */
+		feeds[i].namew = colw(feeds[i].name);
+		feeds[i].nameplain = utf8width(feeds[i].name) != -1;
+		feeds[i].reload = 1;
+	}
+	if (bgcount) {
+		if (pipe(countpipe) == -1)
+			die("pipe");
+		for (i = 0; i < 2; i++) {
+			fcntl(countpipe[i], F_SETFL, O_NONBLOCK);
+			fcntl(countpipe[i], F_SETFD, FD_CLOEXEC);
+		}
+	}
+	/* writing to a program which exited returns EPIPE */
+	memset(&sa, 0, sizeof(sa));
+	sigemptyset(&sa.sa_mask);
+	sa.sa_handler = SIG_IGN;
+	sigaction(SIGPIPE, &sa, NULL);
+
+	if (pipe(sigpipe) == -1)
+		die("pipe");
+	for (i = 0; i < 2; i++) {
+		fcntl(sigpipe[i], F_SETFL, O_NONBLOCK);
+		fcntl(sigpipe[i], F_SETFD, FD_CLOEXEC);
+	}
 	feeds_set(&feeds[0]);
 	urls_read();
 	feeds_load(feeds, nfeeds);
-	urls_free();
+	if (autoreload)
+		watch_init();
 
 	if (!isatty(0)) {
 		if ((fd = open("/dev/tty", O_RDONLY)) == -1)
@@ -2147,7 +6199,7 @@ main(int argc, char *argv[])
 	updatesidebar();
 	updategeom();
 	updatetitle();
-	draw();
+	STATS_TIME(StatDraw, draw());
 
 	while (1) {
 		if ((ch = readch()) < 0)
@@ -2315,29 +6367,21 @@ nextpage:
 			if (ch == '?' || ch == '/') {
 				tmp = ch == '?' ? "backward" : "forward";
 				free(search);
+				searchfrom = p->pos;
+				searchdir = ch == '?' ? -1 : 1;
 				search = uiprompt(statusbar.x, statusbar.y,
-				                  "Search (%s):", tmp);
+				                  search_update, "Search (%s):", tmp);
 				statusbar.dirty = 1;
+				/* search from the position before the prompt */
+				pane_setpos(p, searchfrom);
 			}
 			if (!search || !p->nrows)
 				break;
 
-			if (ch == '/' || ch == 'n') {
-				/* forward */
-				for (pos = p->pos + 1; pos < p->nrows; pos++) {
-					if (pane_row_match(p, pane_row_get(p, pos), search)) {
-						pane_setpos(p, pos);
-						break;
-					}
-				}
-			} else {
-				/* backward */
-				for (pos = p->pos - 1; pos >= 0; pos--) {
-					if (pane_row_match(p, pane_row_get(p, pos), search)) {
-						pane_setpos(p, pos);
-						break;
-					}
-				}
+			dir = ch == '/' || ch == 'n' ? 1 : -1;
+			if ((pos = pane_search(p, p->pos + dir, search, dir)) != -1) {
+				pane_setpos(p, pos);
+				search_count(p, pos, search);
 			}
 			break;
 		case 12: /* ^L, redraw */
@@ -2415,6 +6459,34 @@ openitem:
 				markread(p, p->pos, p->pos, ch == 'r');
 			}
 			break;
+		case 'S': /* items: cycle the sort order */
+			items_setorder((itemsort + 1) % SortLast, itemfilter);
+			break;
+		case 'U': /* items: toggle showing only new */
+			items_setorder(itemsort, itemfilter ^ FilterNew);
+			break;
+		case 'A': /* items: toggle showing only with an enclosure */
+			items_setorder(itemsort, itemfilter ^ FilterEnclosure);
+			break;
+		case 'C': /* items: filter by category, empty input clears it */
+			tmp = uiprompt(statusbar.x, statusbar.y, NULL, "Category:");
+			statusbar.dirty = 1;
+			free(itemcategory);
+			if (tmp && *tmp) {
+				itemcategory = tmp;
+				views_stale(FilterCategory);
+				items_setorder(itemsort, itemfilter | FilterCategory);
+			} else {
+				free(tmp);
+				itemcategory = NULL;
+				items_setorder(itemsort, itemfilter & ~FilterCategory);
+			}
+			break;
+#ifdef SFEED_STATS
+		case 'I': /* toggle showing the stats in the statusbar */
+			statsshow = !statsshow;
+			break;
+#endif
 		case 's': /* toggle layout between monocle or non-monocle */
 			setlayout(layout == LayoutMonocle ? prevlayout : LayoutMonocle);
 			updategeom();
@@ -2431,9 +6503,21 @@ openitem:
 event:
 		if (ch == EOF)
 			goto end;
-		else if (ch == -3 && sigstate == 0)
+		else if (ch == -3 && sigstate == 0 && !countsupdated &&
+		         !watch_ready() && !marks_ready())
 			continue; /* just a time-out, nothing to do */
 
+		if (marks_ready())
+			marks_flush();
+		if (watch_ready())
+			feeds_reloadchanged();
+
+		if (countsupdated) {
+			countsupdated = 0;
+			updatesidebar();
+			updatetitle();
+		}
+
 		switch (sigstate) {
 		case SIGHUP:
 			feeds_reloadall();
@@ -2441,6 +6525,7 @@ event:
 			break;
 		case SIGINT:
 		case SIGTERM:
+			marks_flush();
 			cleanup();
 			_exit(128 + sigstate);
 		case SIGWINCH:
@@ -2450,10 +6535,18 @@ event:
 			break;
 		}
 
-		draw();
+		STATS_TIME(StatDraw, draw());
 	}
 end:
+	i = marks_flush() == -1 ? nmarks : 0;
 	cleanup();
+#ifdef SFEED_STATS
+	stats_dump();
+#endif
+	if (i) {
+		fprintf(stderr, "sfeed_curses: unflushed marks: %zu\n", i);
+		return 1;
+	}
 
 	return 0;
 }